@@ -6,13 +6,24 @@
 #include <chrono>
 #include <functional>
 #include <vector>
+#include <map>
+#include <condition_variable>
 #include <gio/gio.h>
 #include "TestData.h"
 #include "FileTransfer.h"
 
+class ShmRing;
+
+// 数据连接条带数上限
+#define MAX_CONNECTION_STRIPES 8
+
 class ClientDBus {
 public:
     using ConnectionCallback = std::function<void(bool connected)>;
+    // 异步调用完成回调，在内部调度线程上执行，不能阻塞
+    using SendCallback = std::function<void(bool ok)>;
+    // 会话批次的完成回调，额外带回服务端授予的在途额度（字节）
+    using CreditCallback = std::function<void(bool ok, uint32_t credit)>;
     
     ClientDBus();
     ~ClientDBus();
@@ -31,10 +42,43 @@ public:
     
     // 文件传输相关方法
     bool SendFileChunk(const FileChunk& chunk);
+    // 批量发送同一传输的多个文件块（元数据取自第一个块），单次调用最多携带MAX_BATCH_BYTES负载
+    bool SendFileChunks(const std::vector<FileChunk>& chunks);
+    // 异步批量发送：接管chunks并零拷贝编组，应答到达后通过done回调结果；连接不可用时立即以false回调
+    void SendFileChunksAsync(std::vector<FileChunk> chunks, SendCallback done);
+    // 传输会话：登记一次元数据并协商块大小，返回句柄（失败为0）、块大小、总块数和初始额度；传输结束或放弃时关闭
+    TransferSession OpenTransfer(const FileChunk& meta, uint32_t chunkSize = DEFAULT_CHUNK_SIZE);
+    bool CloseTransfer(uint32_t handle);
+    // 按会话发送一批块，消息中只携带(索引, 负载)；异步版本接管batch并零拷贝编组。
+    // 应答带回服务端授予的在途额度，发送端在途字节数不应超过它
+    bool SendSessionChunks(uint32_t handle, const ChunkBatch& batch, uint32_t* credit = nullptr);
+    void SendSessionChunksAsync(uint32_t handle, ChunkBatch batch, CreditCallback done);
+    // 流式发送一批块：调用带NO_REPLY_EXPECTED标志，消息写出后立即返回，接收情况由ChunksAcked信号确认
+    bool StreamSessionChunks(uint32_t handle, const ChunkBatch& batch);
+    // 选择性确认：OpenTransfer后按传输ID跟踪服务端推送的ChunksAcked信号，本地保存已接收位图
+    // 等待已确认块数达到target，每次有新确认都重新计时，timeout_ms内没有进展时返回false
+    bool WaitForAcks(const std::string& transferId, int target, int timeout_ms);
+    // 等待OpenTransfer后服务端推送的完整已接收集合
+    bool WaitForAckSnapshot(const std::string& transferId, int timeout_ms);
+    // 本地位图中[0, totalChunks)范围内尚未确认的块，按连续范围返回
+    std::vector<ChunkRange> GetUnackedRanges(const std::string& transferId, int totalChunks);
+    int GetAckedChunks(const std::string& transferId);
+    uint32_t GetAckCredit(const std::string& transferId);
+    // 停止跟踪传输的确认（传输结束或放弃时调用）
+    void ForgetTransferAcks(const std::string& transferId);
+    // 通过Unix FD传递发送文件范围[offset, offset + length)，meta.fileIndex为起始块索引；fd仍归调用方所有
+    bool SendFileRange(int fd, uint64_t offset, uint64_t length, const FileChunk& meta);
+    // 共享内存传输：把环形缓冲区的描述符交给服务端，之后数据只经过共享内存
+    bool OpenShmTransfer(const ShmRing& ring, const FileChunk& meta);
+    bool CommitShmTransfer(const std::string& transferId);
     
     // 断点续传相关方法
     TransferStatus GetTransferStatus(const std::string& transferId, const std::string& userid, const std::string& fileName);
+    // 一次调用取回传输状态、真实的开始/更新时间和已接收位图（服务端按紧凑位图或游程编码传输）
+    TransferStatus GetTransferSnapshot(const std::string& transferId, const std::string& userid, const std::string& fileName);
     std::vector<int> GetMissingChunks(const std::string& transferId, const std::string& userid, const std::string& fileName);
+    // 按会话分页获取缺失块范围：从cursor开始最多limit个范围，next返回下一页起始块索引（已到末尾为0）
+    bool GetMissingRanges(uint32_t handle, uint32_t cursor, uint32_t limit, std::vector<ChunkRange>& ranges, uint32_t* next);
     bool ResumeTransfer(const std::string& transferId, const std::string& userid, const std::string& videoPath);
 
     bool is_connected() const;
@@ -42,17 +86,40 @@ public:
     void enable_auto_reconnect(bool enable);
     void set_reconnect_interval(int seconds);
     void add_connection_callback(const ConnectionCallback& callback);
+    // 是否把文件传输升级为与服务端的点对点连接（默认开启，服务端不支持时自动使用总线）
+    void enable_peer_connection(bool enable);
+    // 文件数据调用在count条独立连接间轮转（默认1，即只用主数据连接），多个发送线程可同时驱动多条连接
+    void set_connection_stripes(int count);
     
     // GDBus连接关闭回调处理
     void on_connection_closed(gboolean remote_peer_vanished, GError* error);
+    // 服务名所有权变化回调（服务上线/下线）
+    void on_service_availability_changed(bool available);
+    // 调用失败处理（连接断开时标记并触发重连），同步与异步数据调用共用
+    void on_call_failed(const char* method, GError* error);
+    // ChunksAcked信号处理：合并到本地确认位图
+    void on_chunks_acked(GVariant* parameters);
+    // 在一条数据连接上订阅ChunksAcked：服务端把确认单播到打开传输的那条连接，
+    // 点对点连接上的消息不带发送者，不按服务名过滤
+    void subscribe_chunk_acks(GDBusConnection* conn, bool peer);
     
 public:
     bool init();
 
 private:
     GDBusConnection* conn_;
+    GDBusConnection* ctrl_conn_ = nullptr;   // 控制连接：属性方法和心跳专用，与文件数据隔离
+    GDBusConnection* peer_conn_ = nullptr;   // 点对点连接，绕过总线守护进程传输文件数据
+    std::atomic<bool> peer_enabled_{true};
+    std::string peer_address_;               // 最近一次点对点连接的地址，条带连接复用
+    std::vector<GDBusConnection*> stripe_conns_; // 额外的数据连接（条带）
+    bool stripes_are_peer_ = false;
+    int stripe_count_ = 1;
+    std::atomic<size_t> next_stripe_{0};
     std::recursive_mutex mutex_;
     std::atomic<bool> is_connected_{false};
+    std::atomic<bool> service_available_{false}; // 服务名当前是否有所有者
+    guint name_watch_id_ = 0;
     std::atomic<bool> auto_reconnect_{false};
     std::atomic<bool> reconnect_thread_active_{false};
     std::atomic<int> reconnect_interval_{5}; // 默认5秒重连间隔
@@ -67,4 +134,35 @@ private:
     
     // 心跳检测工作线程
     void heartbeat_worker();
+    bool ping(int timeout_ms);
+
+    // 点对点连接与条带管理（调用方需持有mutex_）
+    bool upgrade_to_peer();
+    void drop_peer_connection();
+    GDBusConnection* data_connection(const char** destination);
+    void open_stripes();
+    void close_stripes();
+    // 取得一条数据连接的引用（内部短暂加锁），调用期间不持有mutex_
+    GDBusConnection* ref_data_connection(const char** destination);
+
+    // 控制连接管理
+    void open_control_connection();
+    void close_control_connection();
+    GDBusConnection* ref_control_connection();
+
+    // 选择性确认：每个传输的本地已接收位图，由ChunksAcked信号更新
+    struct AckedTransfer {
+        ChunkBitmap received;
+        uint32_t credit = 0;
+        bool snapshotSeen = false;   // 最近一次OpenTransfer之后是否收到过完整集合
+        uint64_t updates = 0;        // 收到的确认次数，用于判断等待期间是否有进展
+    };
+    std::map<std::string, AckedTransfer> acked_transfers_;
+    std::mutex ack_mutex_;
+    std::condition_variable ack_cv_;
+
+    // 异步调用调度线程：独占async_context_并运行主循环，所有异步应答都在该线程回调
+    GMainContext* async_context_;
+    GMainLoop* async_loop_;
+    std::thread async_thread_;
 };
\ No newline at end of file
@@ -1,17 +1,38 @@
 #pragma once
 #include <sys/types.h>
 #include <string>
+#include <cstdint>
 #include "ThreadPool.h"
 
 // 前向声明
 class ClientDBus;
 
+// 文件数据的发送方式
+enum class SendMode {
+    Batch,      // 文件块编组为ay数组批量发送（默认）
+    FdPassing,  // 通过Unix FD传递源文件，服务端直接拷贝到目标文件
+    SharedMemory, // 共享内存环形缓冲区传输数据，D-Bus只做开始/结束控制
+    Streaming,  // 会话块以NO_REPLY_EXPECTED流式发出，按服务端推送的选择性确认只重传缺口
+};
+
+// 批量编组模式下每个文件默认的在途字节数上限（约4个批次）
+#define DEFAULT_INFLIGHT_BYTES (16 * 1024 * 1024)
+
 // 初始化文件发送器（创建内存池和线程池）
 bool init_file_sender(size_t thread_pool_size = 0);
 
 // 设置DBus客户端实例
 void set_dbus_client(ClientDBus* dbus_client);
 
+// 设置文件数据的发送方式
+void set_send_mode(SendMode mode);
+
+// 设置批量编组模式下每个文件的在途字节数上限（不足一个批次时按一个批次计）
+void set_inflight_window(size_t max_bytes);
+
+// 设置批量编组模式向服务端请求的块大小，实际值由OpenTransfer协商（服务端不支持会话时为FILE_CHUNK_SIZE）
+void set_chunk_size(uint32_t chunk_size);
+
 // 清理文件发送器（释放内存池和线程池）
 void cleanup_file_sender();
 
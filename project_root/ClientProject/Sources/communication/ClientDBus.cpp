@@ -1,4 +1,6 @@
 #include "ClientDBus.h"
+#include <gio/gunixfdlist.h>
+#include "ShmRing.h"
 #include <iostream>
 #include <cstring>
 #include <mutex>
@@ -6,6 +8,9 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <algorithm>
+#include <memory>
+#include <cerrno>
 
 // 全局互斥锁，用于保护std::cout
 static std::mutex cout_mutex;
@@ -14,6 +19,124 @@ static const char* SERVICE_NAME = "com.example.TestService";
 static const char* OBJECT_PATH = "/com/example/TestService";
 static const char* INTERFACE_NAME = "com.example.ITestService";
 
+// 同步调用期间持有的连接引用，离开作用域时释放
+using ConnectionRef = std::unique_ptr<GDBusConnection, void(*)(gpointer)>;
+
+// 释放负载包装持有的缓冲区引用
+static void release_payload_owner(gpointer owner) {
+    delete static_cast<std::shared_ptr<const void>*>(owner);
+}
+
+// 把块负载直接包装为ay，不逐字节构建、也不额外拷贝。
+// owner为空时借用chunk.data，调用方须保证其在调用期间有效；否则GVariant持有owner引用直到释放
+static GVariant* wrap_chunk_payload(const FileChunk& chunk, const std::shared_ptr<const void>& owner) {
+    if (!owner) {
+        return g_variant_new_from_data(G_VARIANT_TYPE_BYTESTRING, chunk.data, chunk.chunkLength, TRUE, nullptr, nullptr);
+    }
+    return g_variant_new_from_data(G_VARIANT_TYPE_BYTESTRING, chunk.data, chunk.chunkLength, TRUE,
+                                   release_payload_owner, new std::shared_ptr<const void>(owner));
+}
+
+// 构建SendFileChunks的参数：(index, payload)数组，同一批次共享传输元数据
+static GVariant* build_file_chunks_params(const std::vector<FileChunk>& chunks,
+                                          const std::shared_ptr<const void>& owner = nullptr) {
+    GVariantBuilder* chunks_builder = g_variant_builder_new(G_VARIANT_TYPE("a(iay)"));
+    for (const FileChunk& chunk : chunks) {
+        g_variant_builder_add(chunks_builder, "(i@ay)", chunk.fileIndex, wrap_chunk_payload(chunk, owner));
+    }
+
+    const FileChunk& meta = chunks.front();
+    GVariant* params = g_variant_new(
+        "(a(iay)ssutus)",
+        chunks_builder,
+        meta.userid,
+        meta.fileName,
+        (guint)meta.totalChunks,
+        (guint64)meta.fileLength,
+        (guint)meta.fileMode,
+        meta.transferId
+    );
+    g_variant_builder_unref(chunks_builder);
+    return params;
+}
+
+// 构建SendSessionChunks的参数：会话句柄 + (index, payload)数组，元数据已在OpenTransfer时登记。
+// 负载直接引用batch.data，owner为空时借用，否则每个元素持有owner引用
+static GVariant* build_session_chunks_params(uint32_t handle, const ChunkBatch& batch,
+                                             const std::shared_ptr<const void>& owner = nullptr) {
+    GVariantBuilder* chunks_builder = g_variant_builder_new(G_VARIANT_TYPE("a(iay)"));
+    for (size_t i = 0; i < batch.indices.size(); ++i) {
+        const char* data = batch.data.data() + i * batch.chunkSize;
+        GVariant* payload = owner ?
+            g_variant_new_from_data(G_VARIANT_TYPE_BYTESTRING, data, batch.lengths[i], TRUE,
+                                    release_payload_owner, new std::shared_ptr<const void>(owner)) :
+            g_variant_new_from_data(G_VARIANT_TYPE_BYTESTRING, data, batch.lengths[i], TRUE, nullptr, nullptr);
+        g_variant_builder_add(chunks_builder, "(i@ay)", batch.indices[i], payload);
+    }
+
+    GVariant* params = g_variant_new("(ua(iay))", (guint32)handle, chunks_builder);
+    g_variant_builder_unref(chunks_builder);
+    return params;
+}
+
+// 一次待发出的异步调用，在调度线程上发起并在应答回调中释放。
+// 应答为(b)或(bu)，后者的u是服务端授予的在途额度
+struct AsyncCallRequest {
+    ClientDBus* client;
+    GDBusConnection* conn;
+    const char* destination;
+    const char* method;
+    GVariant* params;
+    const char* reply_type;
+    ClientDBus::CreditCallback done;
+};
+
+// 异步调用应答回调（调度线程）
+static void async_call_ready(GObject* source, GAsyncResult* res, gpointer user_data) {
+    AsyncCallRequest* request = static_cast<AsyncCallRequest*>(user_data);
+    GError* error = nullptr;
+    GVariant* result = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+
+    gboolean ret = FALSE;
+    guint32 credit = 0;
+    if (result) {
+        if (g_variant_is_of_type(result, G_VARIANT_TYPE("(bu)"))) {
+            g_variant_get(result, "(bu)", &ret, &credit);
+        } else {
+            g_variant_get(result, "(b)", &ret);
+        }
+        g_variant_unref(result);
+    } else {
+        request->client->on_call_failed(request->method, error);
+        if (error) g_error_free(error);
+    }
+
+    request->done(ret, credit);
+    g_object_unref(request->conn);
+    delete request;
+}
+
+// 在调度线程上发起异步调用，应答回调属于该线程的默认上下文
+static gboolean dispatch_async_call(gpointer user_data) {
+    AsyncCallRequest* request = static_cast<AsyncCallRequest*>(user_data);
+    g_dbus_connection_call(
+        request->conn,
+        request->destination,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        request->method,
+        request->params,
+        G_VARIANT_TYPE(request->reply_type),
+        G_DBUS_CALL_FLAGS_NONE,
+        30000,
+        nullptr,
+        async_call_ready,
+        request
+    );
+    g_variant_unref(request->params);
+    return G_SOURCE_REMOVE;
+}
+
 // GDBus连接关闭回调函数
 static void connection_closed_callback(GDBusConnection* connection, gboolean remote_peer_vanished, GError* error, gpointer user_data) {
     ClientDBus* client = static_cast<ClientDBus*>(user_data);
@@ -22,9 +145,27 @@ static void connection_closed_callback(GDBusConnection* connection, gboolean rem
     }
 }
 
+// 服务名出现/消失回调，在创建监视时所在线程的默认主上下文中执行
+static void service_name_appeared_callback(GDBusConnection*, const gchar*, const gchar*, gpointer user_data) {
+    static_cast<ClientDBus*>(user_data)->on_service_availability_changed(true);
+}
+
+static void service_name_vanished_callback(GDBusConnection*, const gchar*, gpointer user_data) {
+    static_cast<ClientDBus*>(user_data)->on_service_availability_changed(false);
+}
+
 ClientDBus::ClientDBus() : conn_(nullptr) {
     // 启用自动重连
     auto_reconnect_ = true;
+
+    // 启动异步调用调度线程
+    async_context_ = g_main_context_new();
+    async_loop_ = g_main_loop_new(async_context_, FALSE);
+    async_thread_ = std::thread([this]() {
+        g_main_context_push_thread_default(async_context_);
+        g_main_loop_run(async_loop_);
+        g_main_context_pop_thread_default(async_context_);
+    });
     
     // 启动心跳检测
     heartbeat_active_ = true;
@@ -47,6 +188,27 @@ ClientDBus::~ClientDBus() {
     if (reconnect_thread_.joinable()) {
         reconnect_thread_.join();
     }
+
+    // 停止异步调用调度线程
+    g_main_loop_quit(async_loop_);
+    if (async_thread_.joinable()) {
+        async_thread_.join();
+    }
+    g_main_loop_unref(async_loop_);
+    g_main_context_unref(async_context_);
+
+    if (name_watch_id_ != 0) {
+        g_bus_unwatch_name(name_watch_id_);
+        name_watch_id_ = 0;
+    }
+
+    close_stripes();
+    close_control_connection();
+    if (peer_conn_) {
+        g_dbus_connection_close_sync(peer_conn_, nullptr, nullptr);
+        g_object_unref(peer_conn_);
+        peer_conn_ = nullptr;
+    }
     
     if (conn_) {
         g_object_unref(conn_);
@@ -62,6 +224,11 @@ void ClientDBus::on_connection_closed(gboolean remote_peer_vanished, GError* err
     }
     
     // 清理连接资源
+    service_available_ = false;
+    if (name_watch_id_ != 0) {
+        g_bus_unwatch_name(name_watch_id_);
+        name_watch_id_ = 0;
+    }
     if (conn_) {
         // 断开信号连接
         g_signal_handlers_disconnect_by_data(conn_, this);
@@ -101,6 +268,14 @@ bool ClientDBus::init() {
     std::lock_guard<std::recursive_mutex> lock(mutex_);
     
     // 清理现有连接
+    drop_peer_connection();
+    close_stripes();
+    close_control_connection();
+    service_available_ = false;
+    if (name_watch_id_ != 0) {
+        g_bus_unwatch_name(name_watch_id_);
+        name_watch_id_ = 0;
+    }
     if (conn_) {
         g_object_unref(conn_);
         conn_ = nullptr;
@@ -141,6 +316,21 @@ bool ClientDBus::init() {
     
     // 设置GDBus连接关闭信号监听
     g_signal_connect(conn_, "closed", G_CALLBACK(connection_closed_callback), this);
+
+    // 属性方法和心跳使用独立的控制连接，避免排在大批量文件数据之后
+    open_control_connection();
+
+    // 服务可用性：先同步探测一次，之后由服务名所有权变化驱动，不再逐次RPC检查
+    service_available_ = ping(1000);
+    name_watch_id_ = g_bus_watch_name_on_connection(
+        conn_,
+        SERVICE_NAME,
+        G_BUS_NAME_WATCHER_FLAGS_NONE,
+        service_name_appeared_callback,
+        service_name_vanished_callback,
+        this,
+        nullptr
+    );
     
     // 通知连接状态变化
     {
@@ -241,9 +431,235 @@ bool ClientDBus::init() {
         nullptr,
         nullptr
     );
+    // ChunksAcked：流式发送的选择性确认
+    subscribe_chunk_acks(conn_, false);
+
+    // 批量数据改走点对点连接，失败时继续使用总线连接
+    if (peer_enabled_) {
+        upgrade_to_peer();
+    }
+    open_stripes();
     return true;
 }
 
+void ClientDBus::subscribe_chunk_acks(GDBusConnection* conn, bool peer) {
+    g_dbus_connection_signal_subscribe(
+        conn,
+        peer ? nullptr : SERVICE_NAME,
+        INTERFACE_NAME,
+        "ChunksAcked",
+        OBJECT_PATH,
+        nullptr,
+        G_DBUS_SIGNAL_FLAGS_NONE,
+        [](GDBusConnection*, const gchar*, const gchar*, const gchar*, const gchar*, GVariant* parameters, gpointer user_data) {
+            static_cast<ClientDBus*>(user_data)->on_chunks_acked(parameters);
+        },
+        this,
+        nullptr
+    );
+}
+
+// 通过总线查询服务端的点对点地址并直连，调用方需持有mutex_
+bool ClientDBus::upgrade_to_peer() {
+    drop_peer_connection();
+    if (!conn_) {
+        return false;
+    }
+
+    GError* error = nullptr;
+    GVariant* result = g_dbus_connection_call_sync(
+        conn_,
+        SERVICE_NAME,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        "GetPeerAddress",
+        nullptr,
+        G_VARIANT_TYPE("(s)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        2000, // 2秒超时
+        nullptr,
+        &error
+    );
+    if (!result) {
+        std::cout << "[ClientDBus] 服务端未提供点对点地址，文件传输经总线转发: "
+                  << (error ? error->message : "unknown") << std::endl;
+        if (error) g_error_free(error);
+        return false;
+    }
+
+    const gchar* address = nullptr;
+    g_variant_get(result, "(&s)", &address);
+    if (address && address[0] != '\0') {
+        peer_conn_ = g_dbus_connection_new_for_address_sync(
+            address, G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT, nullptr, nullptr, &error);
+        if (peer_conn_) {
+            peer_address_ = address;
+            subscribe_chunk_acks(peer_conn_, true);
+            std::cout << "[ClientDBus] 已建立点对点连接: " << address << std::endl;
+        } else {
+            std::cerr << "[ClientDBus] 点对点连接失败，文件传输经总线转发: "
+                      << (error ? error->message : "unknown") << std::endl;
+            if (error) g_error_free(error);
+        }
+    }
+    g_variant_unref(result);
+    return peer_conn_ != nullptr;
+}
+
+// 关闭点对点连接，调用方需持有mutex_
+void ClientDBus::drop_peer_connection() {
+    if (peer_conn_) {
+        g_dbus_connection_close_sync(peer_conn_, nullptr, nullptr);
+        g_object_unref(peer_conn_);
+        peer_conn_ = nullptr;
+    }
+}
+
+// 文件传输使用的连接：点对点连接可用时直接发给服务端（无目标名），否则经总线转发，调用方需持有mutex_
+GDBusConnection* ClientDBus::data_connection(const char** destination) {
+    if (peer_conn_ && g_dbus_connection_is_closed(peer_conn_)) {
+        std::cerr << "[ClientDBus] 点对点连接已关闭，回退到总线连接" << std::endl;
+        g_object_unref(peer_conn_);
+        peer_conn_ = nullptr;
+    }
+
+    if (peer_conn_) {
+        *destination = nullptr;
+        return peer_conn_;
+    }
+    *destination = SERVICE_NAME;
+    return conn_;
+}
+
+// 为一次数据调用取得连接引用：只在挑选连接时持有mutex_，调用本身可与其他线程并发。
+// 开启条带时在主数据连接与各条带连接之间轮转，返回的连接需由调用方g_object_unref
+GDBusConnection* ClientDBus::ref_data_connection(const char** destination) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    if (!conn_) {
+        return nullptr;
+    }
+
+    GDBusConnection* conn = data_connection(destination);
+    if (!stripe_conns_.empty()) {
+        size_t slot = next_stripe_++ % (stripe_conns_.size() + 1);
+        if (slot > 0 && !g_dbus_connection_is_closed(stripe_conns_[slot - 1])) {
+            conn = stripe_conns_[slot - 1];
+            *destination = stripes_are_peer_ ? nullptr : SERVICE_NAME;
+        }
+    }
+    return G_DBUS_CONNECTION(g_object_ref(conn));
+}
+
+// 按条带数补齐额外的数据连接：有点对点地址时直连服务端，否则各自独立连接会话总线，调用方需持有mutex_
+void ClientDBus::open_stripes() {
+    if (!conn_ || !stripe_conns_.empty() || stripe_count_ <= 1) {
+        return;
+    }
+
+    GError* error = nullptr;
+    stripes_are_peer_ = (peer_conn_ != nullptr);
+    gchar* address = nullptr;
+    if (stripes_are_peer_) {
+        address = g_strdup(peer_address_.c_str());
+    } else {
+        address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, nullptr, &error);
+        if (!address) {
+            std::cerr << "[ClientDBus] 获取会话总线地址失败，不使用条带连接: "
+                      << (error ? error->message : "unknown") << std::endl;
+            if (error) g_error_free(error);
+            return;
+        }
+    }
+
+    GDBusConnectionFlags flags = stripes_are_peer_ ?
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT :
+        static_cast<GDBusConnectionFlags>(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                          G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION);
+    for (int i = 1; i < stripe_count_; ++i) {
+        GDBusConnection* stripe = g_dbus_connection_new_for_address_sync(address, flags, nullptr, nullptr, &error);
+        if (!stripe) {
+            std::cerr << "[ClientDBus] 建立条带连接失败: " << (error ? error->message : "unknown") << std::endl;
+            if (error) g_error_free(error);
+            break;
+        }
+        subscribe_chunk_acks(stripe, stripes_are_peer_);
+        stripe_conns_.push_back(stripe);
+    }
+    g_free(address);
+
+    std::cout << "[ClientDBus] 数据连接条带数: " << (stripe_conns_.size() + 1)
+              << (stripes_are_peer_ ? "（点对点）" : "（总线）") << std::endl;
+}
+
+// 建立专用控制连接：独立的会话总线连接，只承载属性方法和心跳，失败时控制调用回退到主连接。调用方需持有mutex_
+void ClientDBus::open_control_connection() {
+    GError* error = nullptr;
+    gchar* address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, nullptr, &error);
+    if (address) {
+        ctrl_conn_ = g_dbus_connection_new_for_address_sync(
+            address,
+            static_cast<GDBusConnectionFlags>(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                              G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+            nullptr, nullptr, &error);
+        g_free(address);
+    }
+    if (!ctrl_conn_) {
+        std::cerr << "[ClientDBus] 建立控制连接失败，控制调用使用主连接: "
+                  << (error ? error->message : "unknown") << std::endl;
+        if (error) g_error_free(error);
+    }
+}
+
+// 关闭控制连接，调用方需持有mutex_
+void ClientDBus::close_control_connection() {
+    if (ctrl_conn_) {
+        g_dbus_connection_close_sync(ctrl_conn_, nullptr, nullptr);
+        g_object_unref(ctrl_conn_);
+        ctrl_conn_ = nullptr;
+    }
+}
+
+// 取得控制连接的引用，控制连接不可用时退回主连接，返回的连接需由调用方g_object_unref
+GDBusConnection* ClientDBus::ref_control_connection() {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    GDBusConnection* conn = (ctrl_conn_ && !g_dbus_connection_is_closed(ctrl_conn_)) ? ctrl_conn_ : conn_;
+    return conn ? G_DBUS_CONNECTION(g_object_ref(conn)) : nullptr;
+}
+
+// 关闭全部条带连接，调用方需持有mutex_
+void ClientDBus::close_stripes() {
+    for (GDBusConnection* stripe : stripe_conns_) {
+        g_dbus_connection_close_sync(stripe, nullptr, nullptr);
+        g_object_unref(stripe);
+    }
+    stripe_conns_.clear();
+}
+
+void ClientDBus::set_connection_stripes(int count) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    stripe_count_ = std::max(1, std::min(count, MAX_CONNECTION_STRIPES));
+    close_stripes();
+    if (is_connected_) {
+        open_stripes();
+    }
+    std::cout << "[ClientDBus] 设置条带连接数: " << stripe_count_ << std::endl;
+}
+
+void ClientDBus::enable_peer_connection(bool enable) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    peer_enabled_ = enable;
+    if (!enable) {
+        drop_peer_connection();
+    } else if (!peer_conn_ && is_connected_) {
+        upgrade_to_peer();
+    }
+    // 条带连接跟随主数据连接的类型重建
+    close_stripes();
+    if (is_connected_) {
+        open_stripes();
+    }
+}
+
 // 重连工作线程
 void ClientDBus::reconnect_worker() {
     const int max_retries = 10;
@@ -283,35 +699,53 @@ void ClientDBus::reconnect_worker() {
 }
 
 bool ClientDBus::is_connected() const {
-    // 检查连接状态标志
-    if (!is_connected_) {
-        return false;
+    // 缓存状态：总线连接由closed回调维护，服务可用性由服务名监视维护
+    return is_connected_ && service_available_;
+}
+
+// 服务名所有权变化：服务重启后重新建立点对点连接并通知等待方
+void ClientDBus::on_service_availability_changed(bool available) {
+    if (service_available_.exchange(available) == available) {
+        return;
     }
-    
-    // 检查连接对象是否有效
-    if (!conn_) {
+    std::cout << "[ClientDBus] 服务" << (available ? "已上线" : "已下线") << ": " << SERVICE_NAME << std::endl;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        close_stripes();
+        if (!available) {
+            drop_peer_connection();
+        } else {
+            if (peer_enabled_) {
+                upgrade_to_peer();
+            }
+            open_stripes();
+        }
+    }
+
+    std::lock_guard<std::mutex> callback_lock(callback_mutex_);
+    for (const auto& callback : connection_callbacks_) {
+        callback(is_connected());
+    }
+}
+
+// 轻量探测：经控制连接调用服务端无副作用的Ping方法
+bool ClientDBus::ping(int timeout_ms) {
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
+    if (!conn) {
         return false;
     }
-    
-    // 检查服务是否可用（通过简单的ping操作）
+
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestBool",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "Ping",
         nullptr,
-        G_VARIANT_TYPE("(b)"), G_DBUS_CALL_FLAGS_NONE, 1000, nullptr, &error); // 1秒超时
-    
+        nullptr, G_DBUS_CALL_FLAGS_NONE, timeout_ms, nullptr, &error);
     if (!result) {
-        // 如果是连接错误，服务不可用
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            if (error) g_error_free(error);
-            return false;
-        }
-        
-        // 其他错误（如服务不存在）也视为不可用
         if (error) g_error_free(error);
         return false;
     }
-    
+
     g_variant_unref(result);
     return true;
 }
@@ -344,30 +778,15 @@ bool ClientDBus::SetTestBool(bool value) {
         return false;
     }
     
+    // 属性方法走专用控制连接，不与文件数据排队
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "SetTestBool",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "SetTestBool",
         g_variant_new("(b)", value),
         G_VARIANT_TYPE("(b)"), G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error); // 5秒超时
     if (!result) {
-        std::cerr << "[ClientDBus] SetTestBool调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("SetTestBool", error);
         if (error) g_error_free(error);
         return false;
     }
@@ -384,30 +803,15 @@ bool ClientDBus::SetTestInt(int value) {
         return false;
     }
     
+    // 属性方法走专用控制连接，不与文件数据排队
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "SetTestInt",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "SetTestInt",
         g_variant_new("(i)", value),
         G_VARIANT_TYPE("(b)"), G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error); // 5秒超时
     if (!result) {
-        std::cerr << "[ClientDBus] SetTestInt调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("SetTestInt", error);
         if (error) g_error_free(error);
         return false;
     }
@@ -424,30 +828,15 @@ bool ClientDBus::SetTestDouble(double value) {
         return false;
     }
     
+    // 属性方法走专用控制连接，不与文件数据排队
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "SetTestDouble",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "SetTestDouble",
         g_variant_new("(d)", value),
         G_VARIANT_TYPE("(b)"), G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error); // 5秒超时
     if (!result) {
-        std::cerr << "[ClientDBus] SetTestDouble调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("SetTestDouble", error);
         if (error) g_error_free(error);
         return false;
     }
@@ -464,30 +853,15 @@ bool ClientDBus::SetTestString(const std::string& value) {
         return false;
     }
     
+    // 属性方法走专用控制连接，不与文件数据排队
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "SetTestString",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "SetTestString",
         g_variant_new("(s)", value.c_str()),
         G_VARIANT_TYPE("(b)"), G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error); // 5秒超时
     if (!result) {
-        std::cerr << "[ClientDBus] SetTestString调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("SetTestString", error);
         if (error) g_error_free(error);
         return false;
     }
@@ -504,30 +878,15 @@ bool ClientDBus::SetTestInfo(const TestInfo& info) {
         return false;
     }
     
+    // 属性方法走专用控制连接，不与文件数据排队
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "SetTestInfo",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "SetTestInfo",
         g_variant_new("((bids))", info.bool_param, info.int_param, info.double_param, info.string_param.c_str()),
         G_VARIANT_TYPE("(b)"), G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error); // 5秒超时
     if (!result) {
-        std::cerr << "[ClientDBus] SetTestInfo调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("SetTestInfo", error);
         if (error) g_error_free(error);
         return false;
     }
@@ -544,19 +903,14 @@ bool ClientDBus::GetTestBool() {
         return false;
     }
     
+    // 属性方法走专用控制连接，不与文件数据排队
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestBool",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestBool",
         nullptr, G_VARIANT_TYPE("(b)"), G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error); // 5秒超时
     if (!result) {
-        std::cerr << "[ClientDBus] GetTestBool调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-        }
-        
+        on_call_failed("GetTestBool", error);
         if (error) g_error_free(error);
         return false;
     }
@@ -573,29 +927,14 @@ int ClientDBus::GetTestInt() {
         return 0;
     }
     
+    // 属性方法走专用控制连接，不与文件数据排队
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestInt",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestInt",
         nullptr, G_VARIANT_TYPE("(i)"), G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error); // 5秒超时
     if (!result) {
-        std::cerr << "[ClientDBus] GetTestInt调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("GetTestInt", error);
         if (error) g_error_free(error);
         return 0;
     }
@@ -612,29 +951,14 @@ double ClientDBus::GetTestDouble() {
         return 0.0;
     }
     
+    // 属性方法走专用控制连接，不与文件数据排队
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestDouble",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestDouble",
         nullptr, G_VARIANT_TYPE("(d)"), G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error); // 5秒超时
     if (!result) {
-        std::cerr << "[ClientDBus] GetTestDouble调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("GetTestDouble", error);
         if (error) g_error_free(error);
         return 0.0;
     }
@@ -651,29 +975,14 @@ std::string ClientDBus::GetTestString() {
         return "";
     }
     
+    // 属性方法走专用控制连接，不与文件数据排队
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestString",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestString",
         nullptr, G_VARIANT_TYPE("(s)"), G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error); // 5秒超时
     if (!result) {
-        std::cerr << "[ClientDBus] GetTestString调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("GetTestString", error);
         if (error) g_error_free(error);
         return "";
     }
@@ -693,29 +1002,14 @@ TestInfo ClientDBus::GetTestInfo() {
         return info;
     }
     
+    // 属性方法走专用控制连接，不与文件数据排队
+    ConnectionRef conn(ref_control_connection(), g_object_unref);
     GError* error = nullptr;
     GVariant* result = g_dbus_connection_call_sync(
-        conn_, SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestInfo",
+        conn.get(), SERVICE_NAME, OBJECT_PATH, INTERFACE_NAME, "GetTestInfo",
         nullptr, G_VARIANT_TYPE("((bids))"), G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error); // 5秒超时
     if (!result) {
-        std::cerr << "[ClientDBus] GetTestInfo调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("GetTestInfo", error);
         if (error) g_error_free(error);
         return info;
     }
@@ -739,9 +1033,10 @@ bool ClientDBus::SendFileChunk(const FileChunk& chunk) {
     GError* error = nullptr;
     GVariant* result = nullptr;
 
-    std::unique_lock<std::recursive_mutex> lock(mutex_);
-
-    if (!conn_) {
+    // 只在取连接引用时加锁，阻塞调用期间其他发送线程可并发使用连接
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
         std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
         return false;
     }
@@ -752,23 +1047,18 @@ bool ClientDBus::SendFileChunk(const FileChunk& chunk) {
     //           << ", 传输ID: " << (chunk.transferId[0] ? chunk.transferId : "无") << std::endl;
 
     try {
-        // 构建字节数组
-        GVariantBuilder* array_builder = g_variant_builder_new(G_VARIANT_TYPE("ay"));
-        for (size_t i = 0; i < chunk.chunkLength; ++i) {
-            g_variant_builder_add(array_builder, "y", (guchar)chunk.data[i]);
-        }
-        GVariant* byte_array = g_variant_builder_end(array_builder);
-        g_variant_builder_unref(array_builder);
+        // 同步调用期间chunk有效，直接借用其缓冲区
+        GVariant* byte_array = wrap_chunk_payload(chunk, nullptr);
 
         GVariant* params = g_variant_new(
-            "(@ayssiuiiubs)",
+            "(@ayssiuitubs)",
             byte_array,
             chunk.userid,
             chunk.fileName,
             chunk.fileIndex,
             (guint)chunk.totalChunks,
             (gint)chunk.chunkLength,
-            chunk.fileLength,
+            (guint64)chunk.fileLength,
             (guint)chunk.fileMode,
             chunk.isLastChunk,
             chunk.transferId
@@ -777,8 +1067,8 @@ bool ClientDBus::SendFileChunk(const FileChunk& chunk) {
         // std::cout << "[ClientDBus] filemode:" << chunk.fileMode << std::endl;
 
         result = g_dbus_connection_call_sync(
-            conn_,
-            SERVICE_NAME,
+            conn.get(),
+            destination,
             OBJECT_PATH,
             INTERFACE_NAME,
             "SendFileChunk",
@@ -791,24 +1081,7 @@ bool ClientDBus::SendFileChunk(const FileChunk& chunk) {
         );
 
         if (!result) {
-            std::cerr << "[ClientDBus] SendFileChunk调用失败: " << (error ? error->message : "unknown") << std::endl;
-            
-            // 如果是连接错误，标记为断开
-            if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-                is_connected_ = false;
-                std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-                
-                // 启动重连线程
-                if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                    if (reconnect_thread_.joinable()) {
-                        reconnect_thread_.join();
-                    }
-                    reconnect_thread_ = std::thread([this]() {
-                        this->reconnect_worker();
-                    });
-                }
-            }
-            
+            on_call_failed("SendFileChunk", error);
             if (error) g_error_free(error);
             return false;
         }
@@ -830,19 +1103,555 @@ bool ClientDBus::SendFileChunk(const FileChunk& chunk) {
     }
 }
 
+bool ClientDBus::SendFileChunks(const std::vector<FileChunk>& chunks) {
+    if (chunks.empty()) {
+        return true;
+    }
+
+    // 检查连接状态
+    if (!is_connected_) {
+        std::cerr << "[ClientDBus] SendFileChunks失败: 连接已断开" << std::endl;
+        return false;
+    }
+
+    GError* error = nullptr;
+
+    // 只在取连接引用时加锁，阻塞调用期间其他发送线程可并发使用连接
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
+        std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
+        return false;
+    }
+
+    GVariant* params = build_file_chunks_params(chunks);
+
+    GVariant* result = g_dbus_connection_call_sync(
+        conn.get(),
+        destination,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        "SendFileChunks",
+        params,
+        G_VARIANT_TYPE("(b)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        30000, // 批量负载较大，30秒超时
+        nullptr,
+        &error
+    );
+
+    if (!result) {
+        on_call_failed("SendFileChunks", error);
+        if (error) g_error_free(error);
+        return false;
+    }
+
+    gboolean ret;
+    g_variant_get(result, "(b)", &ret);
+    g_variant_unref(result);
+    return ret;
+}
+
+void ClientDBus::SendFileChunksAsync(std::vector<FileChunk> chunks, SendCallback done) {
+    if (chunks.empty()) {
+        done(true);
+        return;
+    }
+
+    // 检查连接状态
+    if (!is_connected_) {
+        done(false);
+        return;
+    }
+
+    const char* destination = nullptr;
+    GDBusConnection* conn = ref_data_connection(&destination);
+    if (!conn) {
+        done(false);
+        return;
+    }
+
+    // 编组在调用线程完成，负载直接引用批次缓冲区，直到消息序列化后随参数一起释放
+    auto batch = std::make_shared<const std::vector<FileChunk>>(std::move(chunks));
+    GVariant* params = g_variant_ref_sink(build_file_chunks_params(*batch, batch));
+    AsyncCallRequest* request = new AsyncCallRequest{this, conn, destination, "SendFileChunks", params, "(b)",
+        [done = std::move(done)](bool ok, uint32_t) { done(ok); }};
+    g_main_context_invoke(async_context_, dispatch_async_call, request);
+}
+
+void ClientDBus::SendSessionChunksAsync(uint32_t handle, ChunkBatch batch, CreditCallback done) {
+    if (batch.indices.empty()) {
+        done(true, 0);
+        return;
+    }
+
+    // 检查连接状态
+    if (!is_connected_) {
+        done(false, 0);
+        return;
+    }
+
+    const char* destination = nullptr;
+    GDBusConnection* conn = ref_data_connection(&destination);
+    if (!conn) {
+        done(false, 0);
+        return;
+    }
+
+    // 块只携带索引和负载，负载直接引用批次缓冲区
+    auto owned = std::make_shared<const ChunkBatch>(std::move(batch));
+    GVariant* params = g_variant_ref_sink(build_session_chunks_params(handle, *owned, owned));
+    AsyncCallRequest* request = new AsyncCallRequest{this, conn, destination, "SendSessionChunks", params, "(bu)",
+                                                     std::move(done)};
+    g_main_context_invoke(async_context_, dispatch_async_call, request);
+}
+
+bool ClientDBus::SendSessionChunks(uint32_t handle, const ChunkBatch& batch, uint32_t* credit) {
+    // 检查连接状态
+    if (!is_connected_) {
+        std::cerr << "[ClientDBus] SendSessionChunks失败: 连接已断开" << std::endl;
+        return false;
+    }
+
+    if (batch.indices.empty()) {
+        return true;
+    }
+
+    GError* error = nullptr;
+
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
+        std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
+        return false;
+    }
+
+    GVariant* result = g_dbus_connection_call_sync(
+        conn.get(),
+        destination,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        "SendSessionChunks",
+        build_session_chunks_params(handle, batch),
+        G_VARIANT_TYPE("(bu)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        30000, // 30秒超时
+        nullptr,
+        &error
+    );
+
+    if (!result) {
+        on_call_failed("SendSessionChunks", error);
+        if (error) g_error_free(error);
+        return false;
+    }
+
+    gboolean ret;
+    guint32 granted = 0;
+    g_variant_get(result, "(bu)", &ret, &granted);
+    g_variant_unref(result);
+    if (credit) {
+        *credit = granted;
+    }
+    return ret;
+}
+
+bool ClientDBus::StreamSessionChunks(uint32_t handle, const ChunkBatch& batch) {
+    if (batch.indices.empty()) {
+        return true;
+    }
+
+    // 检查连接状态
+    if (!is_connected_) {
+        return false;
+    }
+
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
+        return false;
+    }
+
+    // 不等待应答：服务端照常处理，GDBus不会为带NO_REPLY_EXPECTED的调用发出应答。
+    // 消息在send_message返回前完成序列化，负载可以直接借用batch
+    GDBusMessage* message = g_dbus_message_new_method_call(destination, OBJECT_PATH, INTERFACE_NAME, "SendSessionChunks");
+    g_dbus_message_set_body(message, build_session_chunks_params(handle, batch));
+    g_dbus_message_set_flags(message, G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED);
+
+    GError* error = nullptr;
+    gboolean ok = g_dbus_connection_send_message(conn.get(), message, G_DBUS_SEND_MESSAGE_FLAGS_NONE, nullptr, &error);
+    g_object_unref(message);
+
+    if (!ok) {
+        on_call_failed("SendSessionChunks", error);
+        if (error) g_error_free(error);
+        return false;
+    }
+    return true;
+}
+
+TransferSession ClientDBus::OpenTransfer(const FileChunk& meta, uint32_t chunkSize) {
+    TransferSession session;
+
+    // 开始（或重新）跟踪该传输的确认，服务端打开会话后会推送完整的已接收集合
+    {
+        std::lock_guard<std::mutex> lock(ack_mutex_);
+        acked_transfers_[meta.transferId].snapshotSeen = false;
+    }
+
+    // 检查连接状态
+    if (!is_connected_) {
+        std::cerr << "[ClientDBus] OpenTransfer失败: 连接已断开" << std::endl;
+        return session;
+    }
+
+    GError* error = nullptr;
+
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
+        std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
+        return session;
+    }
+
+    GVariant* result = g_dbus_connection_call_sync(
+        conn.get(),
+        destination,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        "OpenTransfer",
+        g_variant_new("(sstusu)",
+                      meta.userid,
+                      meta.fileName,
+                      (guint64)meta.fileLength,
+                      (guint)meta.fileMode,
+                      meta.transferId,
+                      (guint)chunkSize),
+        G_VARIANT_TYPE("(uuuu)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        5000, // 5秒超时
+        nullptr,
+        &error
+    );
+
+    if (!result) {
+        on_call_failed("OpenTransfer", error);
+        if (error) g_error_free(error);
+        return session;
+    }
+
+    guint32 handle = 0;
+    guint32 negotiated = 0;
+    guint32 totalChunks = 0;
+    guint32 credit = 0;
+    g_variant_get(result, "(uuuu)", &handle, &negotiated, &totalChunks, &credit);
+    g_variant_unref(result);
+
+    session.handle = handle;
+    session.chunkSize = negotiated;
+    session.totalChunks = static_cast<int>(totalChunks);
+    session.credit = credit;
+
+    {
+        std::lock_guard<std::mutex> lock(ack_mutex_);
+        AckedTransfer& acked = acked_transfers_[meta.transferId];
+        if (acked.received.size() < session.totalChunks) {
+            acked.received.resize(session.totalChunks);
+        }
+        if (!acked.snapshotSeen) {
+            acked.credit = credit;
+        }
+    }
+    return session;
+}
+
+bool ClientDBus::CloseTransfer(uint32_t handle) {
+    // 检查连接状态
+    if (!is_connected_) {
+        std::cerr << "[ClientDBus] CloseTransfer失败: 连接已断开" << std::endl;
+        return false;
+    }
+
+    GError* error = nullptr;
+
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
+        std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
+        return false;
+    }
+
+    GVariant* result = g_dbus_connection_call_sync(
+        conn.get(),
+        destination,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        "CloseTransfer",
+        g_variant_new("(u)", (guint32)handle),
+        G_VARIANT_TYPE("(b)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        5000, // 5秒超时
+        nullptr,
+        &error
+    );
+
+    if (!result) {
+        on_call_failed("CloseTransfer", error);
+        if (error) g_error_free(error);
+        return false;
+    }
+
+    gboolean ret;
+    g_variant_get(result, "(b)", &ret);
+    g_variant_unref(result);
+    return ret;
+}
+
+void ClientDBus::on_call_failed(const char* method, GError* error) {
+    std::cerr << "[ClientDBus] " << method << "调用失败: " << (error ? error->message : "unknown") << std::endl;
+
+    // 如果是连接错误，标记为断开
+    if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
+        is_connected_ = false;
+        std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
+
+        // 启动重连线程
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
+            if (reconnect_thread_.joinable()) {
+                reconnect_thread_.join();
+            }
+            reconnect_thread_ = std::thread([this]() {
+                this->reconnect_worker();
+            });
+        }
+    }
+}
+
+bool ClientDBus::SendFileRange(int fd, uint64_t offset, uint64_t length, const FileChunk& meta) {
+    // 检查连接状态
+    if (!is_connected_) {
+        std::cerr << "[ClientDBus] SendFileRange失败: 连接已断开" << std::endl;
+        return false;
+    }
+
+    GError* error = nullptr;
+
+    // 只在取连接引用时加锁，阻塞调用期间其他发送线程可并发使用连接
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
+        std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
+        return false;
+    }
+
+    // FD列表内部会dup描述符，调用方的fd不受影响
+    GUnixFDList* fd_list = g_unix_fd_list_new();
+    gint fd_handle = g_unix_fd_list_append(fd_list, fd, &error);
+    if (fd_handle < 0) {
+        std::cerr << "[ClientDBus] 添加文件描述符失败: " << (error ? error->message : "unknown") << std::endl;
+        if (error) g_error_free(error);
+        g_object_unref(fd_list);
+        return false;
+    }
+
+    GVariant* params = g_variant_new(
+        "(httissutus)",
+        fd_handle,
+        (guint64)offset,
+        (guint64)length,
+        meta.fileIndex,
+        meta.userid,
+        meta.fileName,
+        (guint)meta.totalChunks,
+        (guint64)meta.fileLength,
+        (guint)meta.fileMode,
+        meta.transferId
+    );
+
+    GVariant* result = g_dbus_connection_call_with_unix_fd_list_sync(
+        conn.get(),
+        destination,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        "SendFileRange",
+        params,
+        G_VARIANT_TYPE("(b)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        5000, // 5秒超时
+        fd_list,
+        nullptr,
+        nullptr,
+        &error
+    );
+    g_object_unref(fd_list);
+
+    if (!result) {
+        on_call_failed("SendFileRange", error);
+        if (error) g_error_free(error);
+        return false;
+    }
+
+    gboolean ret;
+    g_variant_get(result, "(b)", &ret);
+    g_variant_unref(result);
+    return ret;
+}
+
+bool ClientDBus::OpenShmTransfer(const ShmRing& ring, const FileChunk& meta) {
+    // 检查连接状态
+    if (!is_connected_) {
+        std::cerr << "[ClientDBus] OpenShmTransfer失败: 连接已断开" << std::endl;
+        return false;
+    }
+
+    GError* error = nullptr;
+
+    // 只在取连接引用时加锁，阻塞调用期间其他发送线程可并发使用连接
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
+        std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
+        return false;
+    }
+
+    // 依次附带memfd、数据就绪eventfd、空间就绪eventfd
+    GUnixFDList* fd_list = g_unix_fd_list_new();
+    gint handles[3] = {
+        g_unix_fd_list_append(fd_list, ring.mem_fd(), nullptr),
+        g_unix_fd_list_append(fd_list, ring.data_event_fd(), nullptr),
+        g_unix_fd_list_append(fd_list, ring.space_event_fd(), nullptr)
+    };
+    if (handles[0] < 0 || handles[1] < 0 || handles[2] < 0) {
+        std::cerr << "[ClientDBus] 添加共享内存描述符失败" << std::endl;
+        g_object_unref(fd_list);
+        return false;
+    }
+
+    GVariant* params = g_variant_new(
+        "(hhhssutus)",
+        handles[0],
+        handles[1],
+        handles[2],
+        meta.userid,
+        meta.fileName,
+        (guint)meta.totalChunks,
+        (guint64)meta.fileLength,
+        (guint)meta.fileMode,
+        meta.transferId
+    );
+
+    GVariant* result = g_dbus_connection_call_with_unix_fd_list_sync(
+        conn.get(),
+        destination,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        "OpenShmTransfer",
+        params,
+        G_VARIANT_TYPE("(b)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        5000, // 5秒超时
+        fd_list,
+        nullptr,
+        nullptr,
+        &error
+    );
+    g_object_unref(fd_list);
+
+    if (!result) {
+        on_call_failed("OpenShmTransfer", error);
+        if (error) g_error_free(error);
+        return false;
+    }
+
+    gboolean ret;
+    g_variant_get(result, "(b)", &ret);
+    g_variant_unref(result);
+    return ret;
+}
+
+bool ClientDBus::CommitShmTransfer(const std::string& transferId) {
+    // 检查连接状态
+    if (!is_connected_) {
+        std::cerr << "[ClientDBus] CommitShmTransfer失败: 连接已断开" << std::endl;
+        return false;
+    }
+
+    GError* error = nullptr;
+
+    // 只在取连接引用时加锁，阻塞调用期间其他发送线程可并发使用连接
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
+        std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
+        return false;
+    }
+
+    GVariant* result = g_dbus_connection_call_sync(
+        conn.get(),
+        destination,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        "CommitShmTransfer",
+        g_variant_new("(s)", transferId.c_str()),
+        G_VARIANT_TYPE("(b)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        5000, // 5秒超时
+        nullptr,
+        &error
+    );
+
+    if (!result) {
+        on_call_failed("CommitShmTransfer", error);
+        if (error) g_error_free(error);
+        return false;
+    }
+
+    gboolean ret;
+    g_variant_get(result, "(b)", &ret);
+    g_variant_unref(result);
+    return ret;
+}
+
+// 解析传输状态元组(sisiittbtt)
+static void parse_status_tuple(GVariant* tuple, TransferStatus& status) {
+    const gchar* returnedTransferId = nullptr;
+    gint32 statusCode = 0;
+    const gchar* statusMessage = nullptr;
+    gint32 totalChunks = 0, receivedChunks = 0;
+    guint64 fileLength = 0, receivedLength = 0;
+    gboolean isCompleted = FALSE;
+    guint64 startTime = 0, lastUpdateTime = 0;
+    
+    g_variant_get(tuple, "(&si&siittbtt)", 
+                  &returnedTransferId, &statusCode, &statusMessage,
+                  &totalChunks, &receivedChunks, &fileLength, &receivedLength, 
+                  &isCompleted, &startTime, &lastUpdateTime);
+    
+    status.totalChunks = totalChunks;
+    status.receivedChunks = receivedChunks;
+    status.fileLength = fileLength;
+    status.receivedLength = receivedLength;
+    status.statusCode = statusCode;
+    status.isCompleted = isCompleted;
+    status.startTime = startTime;
+    status.lastUpdateTime = lastUpdateTime;
+}
+
 TransferStatus ClientDBus::GetTransferStatus(const std::string& transferId, const std::string& userid, const std::string& fileName)
 {
     GError* error = nullptr;
     TransferStatus status{};
     
-    std::unique_lock<std::recursive_mutex> lock(mutex_);
-    
     if (!is_connected_) {
         std::cerr << "[ClientDBus] 连接已断开，无法获取传输状态" << std::endl;
         return status;
     }
 
-    if (!conn_) {
+    // 只在取连接引用时加锁，阻塞调用期间其他发送线程可并发使用连接
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
         std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
         return status;
     }
@@ -851,13 +1660,13 @@ TransferStatus ClientDBus::GetTransferStatus(const std::string& transferId, cons
               << " 用户: " << userid << " 文件: " << fileName << std::endl;
     
     GVariant* result = g_dbus_connection_call_sync(
-        conn_,
-        SERVICE_NAME,
+        conn.get(),
+        destination,
         OBJECT_PATH,
         INTERFACE_NAME,
         "GetTransferStatus",
         g_variant_new("(sss)", transferId.c_str(), userid.c_str(), fileName.c_str()),
-        G_VARIANT_TYPE("((sisiiuibtt))"),
+        G_VARIANT_TYPE("((sisiittbtt))"),
         G_DBUS_CALL_FLAGS_NONE,
         5000, // 5秒超时
         nullptr,
@@ -865,66 +1674,77 @@ TransferStatus ClientDBus::GetTransferStatus(const std::string& transferId, cons
     );
     
     if (!result) {
-        std::cerr << "[ClientDBus] GetTransferStatus调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("GetTransferStatus", error);
         if (error) g_error_free(error);
         return status;
     }
     
-    // 解析返回的状态信息，格式为(sisiiuibtt)
-    const gchar* returnedTransferId;
-    gint32 statusCode;
-    const gchar* statusMessage;
-    gint32 totalChunks, receivedChunks, receivedLength;
-    guint fileLength;
-    gboolean isCompleted;
-    guint64 startTime, lastUpdateTime;
+    // 解析返回的状态信息，格式为(sisiittbtt)；该接口不携带位图
+    GVariant* tuple = g_variant_get_child_value(result, 0);
+    parse_status_tuple(tuple, status);
+    g_variant_unref(tuple);
+    g_variant_unref(result);
     
-    g_variant_get(result, "((sisiiuibtt))", 
-                  &returnedTransferId, &statusCode, &statusMessage,
-                  &totalChunks, &receivedChunks, &fileLength, &receivedLength, 
-                  &isCompleted, &startTime, &lastUpdateTime);
+    // 初始化位图
+    status.chunkBitmap.reset(status.totalChunks);
     
-    status.totalChunks = totalChunks;
-    status.receivedChunks = receivedChunks;
-    status.fileLength = fileLength;
-    status.receivedLength = receivedLength;
-    status.statusCode = statusCode;
-    status.isCompleted = isCompleted;
+    return status;
+}
+
+TransferStatus ClientDBus::GetTransferSnapshot(const std::string& transferId, const std::string& userid, const std::string& fileName)
+{
+    GError* error = nullptr;
+    TransferStatus status{};
     
-    // 初始化位图
-    status.chunkBitmap.resize(totalChunks, false);
+    if (!is_connected_) {
+        std::cerr << "[ClientDBus] 连接已断开，无法获取传输快照" << std::endl;
+        return status;
+    }
+
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
+        std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
+        return status;
+    }
     
-    g_variant_unref(result);
+    GVariant* result = g_dbus_connection_call_sync(
+        conn.get(),
+        destination,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        "GetTransferSnapshot",
+        g_variant_new("(sss)", transferId.c_str(), userid.c_str(), fileName.c_str()),
+        G_VARIANT_TYPE("((sisiittbtt)yay)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        5000, // 5秒超时
+        nullptr,
+        &error
+    );
+    
+    if (!result) {
+        on_call_failed("GetTransferSnapshot", error);
+        if (error) g_error_free(error);
+        return status;
+    }
     
-    // std::cout << "[ClientDBus] 传输状态获取成功: " 
-    //           << "传输ID=" << returnedTransferId 
-    //           << ", 状态码=" << statusCode 
-    //           << ", 状态消息=" << statusMessage
-    //           << ", 总块数=" << totalChunks 
-    //           << ", 已接收=" << receivedChunks 
-    //           << ", 文件长度=" << fileLength 
-    //           << ", 已接收长度=" << receivedLength 
-    //           << ", 是否完成=" << (isCompleted ? "是" : "否") 
-    //           << ", 开始时间=" << startTime 
-    //           << ", 最后更新时间=" << lastUpdateTime << std::endl;
+    GVariant* tuple = nullptr;
+    guint8 encoding = BITMAP_ENCODING_PACKED;
+    GVariant* bitmap = nullptr;
+    g_variant_get(result, "(@(sisiittbtt)y@ay)", &tuple, &encoding, &bitmap);
+    parse_status_tuple(tuple, status);
+    
+    // 位图按服务端选择的编码解码，数据损坏时按全部缺失处理
+    gsize bitmap_size = 0;
+    const guint8* bitmap_data = static_cast<const guint8*>(g_variant_get_fixed_array(bitmap, &bitmap_size, sizeof(guint8)));
+    if (!status.decodeBitmap(encoding, bitmap_data, bitmap_size)) {
+        std::cerr << "[ClientDBus] 传输位图解码失败，编码: " << static_cast<int>(encoding) << std::endl;
+        status.chunkBitmap.reset(status.totalChunks);
+    }
     
+    g_variant_unref(bitmap);
+    g_variant_unref(tuple);
+    g_variant_unref(result);
     return status;
 }
 
@@ -933,14 +1753,15 @@ std::vector<int> ClientDBus::GetMissingChunks(const std::string& transferId, con
     GError* error = nullptr;
     std::vector<int> missingChunks{};
     
-    std::unique_lock<std::recursive_mutex> lock(mutex_);
-    
     if (!is_connected_) {
         std::cerr << "[ClientDBus] 连接已断开，无法获取缺失块列表" << std::endl;
         return missingChunks;
     }
 
-    if (!conn_) {
+    // 只在取连接引用时加锁，阻塞调用期间其他发送线程可并发使用连接
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
         std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
         return missingChunks;
     }
@@ -949,8 +1770,8 @@ std::vector<int> ClientDBus::GetMissingChunks(const std::string& transferId, con
               << " 用户: " << userid << " 文件: " << fileName << std::endl;
     
     GVariant* result = g_dbus_connection_call_sync(
-        conn_,
-        SERVICE_NAME,
+        conn.get(),
+        destination,
         OBJECT_PATH,
         INTERFACE_NAME,
         "GetMissingChunks",
@@ -963,24 +1784,7 @@ std::vector<int> ClientDBus::GetMissingChunks(const std::string& transferId, con
     );
     
     if (!result) {
-        std::cerr << "[ClientDBus] GetMissingChunks调用失败: " << (error ? error->message : "unknown") << std::endl;
-        
-        // 如果是连接错误，标记为断开
-        if (error && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)) {
-            is_connected_ = false;
-            std::cerr << "[ClientDBus] 检测到连接断开，将尝试重连" << std::endl;
-            
-            // 启动重连线程
-            if (auto_reconnect_ && (!reconnect_thread_.joinable() || !reconnect_thread_active_)) {
-                if (reconnect_thread_.joinable()) {
-                    reconnect_thread_.join();
-                }
-                reconnect_thread_ = std::thread([this]() {
-                    this->reconnect_worker();
-                });
-            }
-        }
-        
+        on_call_failed("GetMissingChunks", error);
         if (error) g_error_free(error);
         return missingChunks;
     }
@@ -1003,53 +1807,78 @@ std::vector<int> ClientDBus::GetMissingChunks(const std::string& transferId, con
     return missingChunks;
 }
 
-bool ClientDBus::ResumeTransfer(const std::string& transferId, const std::string& userid, const std::string& videoPath)
+bool ClientDBus::GetMissingRanges(uint32_t handle, uint32_t cursor, uint32_t limit,
+                                  std::vector<ChunkRange>& ranges, uint32_t* next)
 {
-    std::unique_lock<std::recursive_mutex> lock(mutex_);
-    
+    GError* error = nullptr;
+    ranges.clear();
+
     if (!is_connected_) {
-        std::cerr << "[ClientDBus] 连接已断开，无法进行断点续传" << std::endl;
+        std::cerr << "[ClientDBus] 连接已断开，无法获取缺失块范围" << std::endl;
         return false;
     }
 
-    if (!conn_) {
+    const char* destination = nullptr;
+    ConnectionRef conn(ref_data_connection(&destination), g_object_unref);
+    if (!conn) {
         std::cerr << "[ClientDBus] DBus连接无效" << std::endl;
         return false;
     }
 
-    size_t lastSlash = videoPath.find_last_of('/');
-    std::string fileName = (lastSlash != std::string::npos) ? videoPath.substr(lastSlash + 1) : videoPath;
-    
-    std::cout << "[ClientDBus] 开始断点续传，传输ID: " << transferId 
-              << " 用户: " << userid << " 文件: " << fileName << "文件路径：" << videoPath << std::endl;
-    
-    // 获取传输状态
-    TransferStatus status = this->GetTransferStatus(transferId, userid, fileName);
+    GVariant* result = g_dbus_connection_call_sync(
+        conn.get(),
+        destination,
+        OBJECT_PATH,
+        INTERFACE_NAME,
+        "GetMissingRanges",
+        g_variant_new("(uuu)", (guint32)handle, (guint32)cursor, (guint32)limit),
+        G_VARIANT_TYPE("(a(uu)u)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        5000, // 5秒超时
+        nullptr,
+        &error
+    );
 
-    std::cout << "[ClientDBus] 断点续传状态获取完成" << std::endl;
-    
-    if (status.totalChunks == 0) {
-        std::cerr << "[ClientDBus] 无法获取传输状态，传输可能不存在" << std::endl;
+    if (!result) {
+        on_call_failed("GetMissingRanges", error);
+        if (error) g_error_free(error);
         return false;
     }
-    
-    if (status.isCompleted) {
-        std::cout << "[ClientDBus] 传输已完成，无需恢复" << std::endl;
-        return true;
+
+    GVariantIter* iter = nullptr;
+    guint32 next_cursor = 0;
+    g_variant_get(result, "(a(uu)u)", &iter, &next_cursor);
+
+    guint32 first = 0;
+    guint32 count = 0;
+    ranges.reserve(g_variant_iter_n_children(iter));
+    while (g_variant_iter_next(iter, "(uu)", &first, &count)) {
+        ranges.push_back({static_cast<int>(first), static_cast<int>(count)});
     }
-    
-    // 获取缺失块列表
-    std::vector<int> missingChunks = this->GetMissingChunks(transferId, userid, fileName);
 
-    std::cout << "[ClientDBus] 断点续传缺失块获取完成" << std::endl;
-    
-    if (missingChunks.empty()) {
-        std::cout << "[ClientDBus] 没有缺失块，传输可能已完成" << std::endl;
-        return true;
+    g_variant_iter_free(iter);
+    g_variant_unref(result);
+
+    if (next) {
+        *next = next_cursor;
+    }
+    return true;
+}
+
+bool ClientDBus::ResumeTransfer(const std::string& transferId, const std::string& userid, const std::string& videoPath)
+{
+    // 不持有mutex_：各步调用自行获取连接引用，续传期间其他文件的发送不受阻塞
+    if (!is_connected_) {
+        std::cerr << "[ClientDBus] 连接已断开，无法进行断点续传" << std::endl;
+        return false;
     }
-    
-    std::cout << "[ClientDBus] 断点续传准备完成，缺失块数: " << missingChunks.size() << std::endl;
 
+    size_t lastSlash = videoPath.find_last_of('/');
+    std::string fileName = (lastSlash != std::string::npos) ? videoPath.substr(lastSlash + 1) : videoPath;
+    
+    std::cout << "[ClientDBus] 开始断点续传，传输ID: " << transferId 
+              << " 用户: " << userid << " 文件: " << fileName << "文件路径：" << videoPath << std::endl;
+    
     // 打开文件
     int fd = open(videoPath.c_str(), O_RDONLY);
     if (fd < 0) {
@@ -1064,97 +1893,261 @@ bool ClientDBus::ResumeTransfer(const std::string& transferId, const std::string
         close(fd);
         return false;
     }
+
+    // 重新打开传输会话：已有传输返回原句柄和原块大小，服务端随后推送完整的已接收集合，
+    // 不再单独查询传输状态和缺失块
+    FileChunk meta(userid, 0, 0, fileName, static_cast<uint64_t>(file_stat.st_size), transferId, 0644);
+    TransferSession session = this->OpenTransfer(meta);
+    if (session.handle == 0) {
+        std::cerr << "[ClientDBus] 无法打开传输会话，停止断点续传" << std::endl;
+        ForgetTransferAcks(transferId);
+        close(fd);
+        return false;
+    }
     
-    // 遍历缺失块，重新发送
-    for (int chunk_index : missingChunks) {
+    // 缺失块按连续范围处理，续传开销与缺口数成正比而不是与块数成正比
+    std::vector<ChunkRange> missingRanges;
+    if (WaitForAckSnapshot(transferId, SACK_TIMEOUT_MS)) {
+        missingRanges = GetUnackedRanges(transferId, session.totalChunks);
+    } else {
+        // 没有收到确认快照（例如信号被总线丢弃），回退到分页查询缺失范围
+        std::cerr << "[ClientDBus] 未收到确认快照，改为查询缺失块范围" << std::endl;
+        std::vector<ChunkRange> page;
+        uint32_t cursor = 0;
+        do {
+            if (!GetMissingRanges(session.handle, cursor, MAX_MISSING_RANGES_PER_PAGE, page, &cursor)) {
+                break;
+            }
+            missingRanges.insert(missingRanges.end(), page.begin(), page.end());
+        } while (cursor != 0);
+    }
+
+    std::cout << "[ClientDBus] 断点续传准备完成，缺失范围数: " << missingRanges.size() 
+              << " 块大小: " << session.chunkSize << std::endl;
+    
+    // 缺失范围切成连续批次流式发送，不等待逐批应答；每轮结束后按确认位图只重传仍缺失的范围
+    const int batch_size = chunks_per_batch(session.chunkSize);
+    const uint64_t file_length = static_cast<uint64_t>(file_stat.st_size);
+    const int max_rounds = 5;
+    ChunkBatch batch;
+    batch.chunkSize = session.chunkSize;
+
+    for (int round = 0; round < max_rounds && !missingRanges.empty(); ++round) {
         // 检查连接是否仍然可用
         if (!is_connected_) {
             std::cerr << "[ClientDBus] 连接断开，停止断点续传" << std::endl;
-            close(fd);
-            return false;
+            break;
         }
-        
-        // 计算块偏移量
-        off_t offset = chunk_index * FILE_CHUNK_SIZE;
-        
-        // 构造文件块
-        FileChunk chunk{};
-        
-        // 设置文件块信息
-        chunk.fileIndex = chunk_index;
-        chunk.totalChunks = status.totalChunks;
-        chunk.fileLength = status.fileLength;
-        chunk.fileMode = 0644;
-        chunk.isLastChunk = (chunk_index == status.totalChunks - 1);
-        
-        // 安全复制字符串
-        strncpy(chunk.userid, userid.c_str(), sizeof(chunk.userid) - 1);
-        chunk.userid[sizeof(chunk.userid) - 1] = '\0';
-        strncpy(chunk.fileName, fileName.c_str(), sizeof(chunk.fileName) - 1);
-        chunk.fileName[sizeof(chunk.fileName) - 1] = '\0';
-        
-        // 设置传输ID
-        strncpy(chunk.transferId, transferId.c_str(), sizeof(chunk.transferId) - 1);
-        chunk.transferId[sizeof(chunk.transferId) - 1] = '\0';
-        
-        // 读取文件数据到chunk.data
-        lseek(fd, offset, SEEK_SET);
-        int read_len = read(fd, chunk.data, sizeof(chunk.data));
-        if (read_len < 0) {
-            std::cerr << "[ClientDBus] 文件读取失败: " << fileName << std::endl;
-            close(fd);
-            return false;
+
+        if (round > 0) {
+            std::cout << "[ClientDBus] 第" << round << "轮重传，未确认范围数: " << missingRanges.size() << std::endl;
         }
-        chunk.chunkLength = read_len;
-        
-        // 发送文件块
-        std::cout << "[ClientDBus] 重新发送文件块: " << chunk.fileName
-                  << " 索引: " << chunk.fileIndex
-                  << " 大小: " << chunk.chunkLength
-                  << " 传输ID: " << chunk.transferId << std::endl;
-        
-        // 尝试发送文件块，如果失败则等待重连
-        int max_retries = 5;
-        int retry_count = 0;
-        bool sent = false;
-        
-        while (retry_count < max_retries) {
-            if (SendFileChunk(chunk)) {
-                // 发送成功
-                sent = true;
-                break;
-            } else {
-                // 发送失败，等待重连
-                retry_count++;
-                std::cout << "[ClientDBus] 发送失败，重试第" << retry_count << "次..." << std::endl;
-                
-                // 等待2秒后重试
-                std::this_thread::sleep_for(std::chrono::seconds(2));
-                
-                // 检查连接是否恢复
-                if (!is_connected_) {
-                    std::cerr << "[ClientDBus] 连接断开，停止断点续传" << std::endl;
-                    close(fd);
-                    return false;
+
+        // 在途（已发出未确认）块数不超过服务端额度，额度不足时至少保留一个批次在途
+        const int acked_base = GetAckedChunks(transferId);
+        int sent = 0;
+        bool send_failed = false;
+        for (const ChunkRange& range : missingRanges) {
+            for (int first = range.first; first < range.first + range.count && !send_failed; first += batch_size) {
+                int count = std::min(batch_size, range.first + range.count - first);
+
+                // 连续的块一次读入批次缓冲区
+                uint64_t offset = static_cast<uint64_t>(first) * batch.chunkSize;
+                size_t length = offset < file_length ?
+                    std::min<uint64_t>(static_cast<uint64_t>(count) * batch.chunkSize, file_length - offset) : 0;
+                batch.data.resize(length);
+                size_t filled = 0;
+                while (filled < length) {
+                    ssize_t n = pread(fd, batch.data.data() + filled, length - filled, offset + filled);
+                    if (n <= 0) {
+                        if (n < 0 && errno == EINTR) continue;
+                        std::cerr << "[ClientDBus] 文件读取失败: " << fileName << std::endl;
+                        this->CloseTransfer(session.handle);
+                        ForgetTransferAcks(transferId);
+                        close(fd);
+                        return false;
+                    }
+                    filled += n;
                 }
+
+                batch.indices.resize(count);
+                batch.lengths.resize(count);
+                for (int i = 0; i < count; ++i) {
+                    size_t chunk_offset = static_cast<size_t>(i) * batch.chunkSize;
+                    batch.indices[i] = first + i;
+                    batch.lengths[i] = static_cast<uint32_t>(
+                        chunk_offset < length ? std::min<size_t>(batch.chunkSize, length - chunk_offset) : 0);
+                }
+
+                int window = std::max(static_cast<int>(GetAckCredit(transferId) / batch.chunkSize), batch_size);
+                if (sent + count - (GetAckedChunks(transferId) - acked_base) > window) {
+                    WaitForAcks(transferId, acked_base + sent + count - window, SACK_TIMEOUT_MS);
+                }
+
+                if (!StreamSessionChunks(session.handle, batch)) {
+                    std::cerr << "[ClientDBus] 发送文件块批次失败: " << fileName
+                              << " 起始索引: " << first << std::endl;
+                    send_failed = true;
+                    break;
+                }
+                sent += count;
+            }
+            if (send_failed) {
+                break;
             }
         }
-        
-        if (!sent) {
-            std::cerr << "[ClientDBus] 发送文件块失败，已达到最大重试次数: " << chunk.fileName << " 索引: " << chunk.fileIndex << std::endl;
-            close(fd);
-            return false;
+
+        // 等待本轮确认；超时仍有缺口时重新打开会话（服务端重启后旧句柄失效），用新的快照确定重传范围
+        if (WaitForAcks(transferId, session.totalChunks, SACK_TIMEOUT_MS)) {
+            missingRanges.clear();
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+        if (!is_connected_) {
+            continue;
+        }
+        TransferSession reopened = this->OpenTransfer(meta, session.chunkSize);
+        if (reopened.handle != 0 && reopened.chunkSize == session.chunkSize) {
+            session.handle = reopened.handle;
+            WaitForAckSnapshot(transferId, SACK_TIMEOUT_MS);
         }
+        missingRanges = GetUnackedRanges(transferId, session.totalChunks);
     }
     
+    // 传输完成时服务端已自动释放会话，未完成时由这里释放
+    this->CloseTransfer(session.handle);
+    ForgetTransferAcks(transferId);
+
     // 关闭文件
     close(fd);
+
+    if (!missingRanges.empty()) {
+        std::cerr << "[ClientDBus] 断点续传未完成，仍缺失范围数: " << missingRanges.size() << std::endl;
+        return false;
+    }
     
     std::cout << "[ClientDBus] 断点续传完成，已重发所有缺失块" << std::endl;
     
     return true;
 }
 
+// ChunksAcked信号处理（默认主上下文线程）：快照替换本地位图，增量只置位新确认的块
+void ClientDBus::on_chunks_acked(GVariant* parameters) {
+    const gchar* transferId = nullptr;
+    gboolean snapshot = FALSE;
+    GVariantIter* ranges = nullptr;
+    guint32 credit = 0;
+    g_variant_get(parameters, "(&sba(ii)u)", &transferId, &snapshot, &ranges, &credit);
+
+    {
+        std::lock_guard<std::mutex> lock(ack_mutex_);
+        auto it = acked_transfers_.find(transferId ? transferId : "");
+        if (it != acked_transfers_.end()) {
+            AckedTransfer& acked = it->second;
+            if (snapshot) {
+                acked.received.reset(acked.received.size());
+                acked.snapshotSeen = true;
+            }
+
+            gint32 first = 0;
+            gint32 count = 0;
+            while (g_variant_iter_next(ranges, "(ii)", &first, &count)) {
+                if (first < 0 || count <= 0) {
+                    continue;
+                }
+                if (acked.received.size() < first + count) {
+                    acked.received.resize(first + count);
+                }
+                acked.received.setRange(first, count);
+            }
+            acked.credit = credit;
+            acked.updates++;
+        }
+    }
+    g_variant_iter_free(ranges);
+    ack_cv_.notify_all();
+}
+
+bool ClientDBus::WaitForAcks(const std::string& transferId, int target, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(ack_mutex_);
+    while (true) {
+        auto it = acked_transfers_.find(transferId);
+        if (it == acked_transfers_.end()) {
+            return false;
+        }
+        if (it->second.received.count() >= target) {
+            return true;
+        }
+
+        // 等待期间有新的确认就重新计时，只有整段超时都没有进展才返回
+        uint64_t updates = it->second.updates;
+        bool progressed = ack_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]() {
+            auto current = acked_transfers_.find(transferId);
+            return current == acked_transfers_.end() || current->second.updates != updates;
+        });
+        if (!progressed) {
+            return false;
+        }
+    }
+}
+
+bool ClientDBus::WaitForAckSnapshot(const std::string& transferId, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(ack_mutex_);
+    return ack_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]() {
+        auto it = acked_transfers_.find(transferId);
+        return it != acked_transfers_.end() && it->second.snapshotSeen;
+    });
+}
+
+std::vector<ChunkRange> ClientDBus::GetUnackedRanges(const std::string& transferId, int totalChunks) {
+    std::vector<ChunkRange> unacked;
+    std::lock_guard<std::mutex> lock(ack_mutex_);
+    auto it = acked_transfers_.find(transferId);
+    int tracked = 0;
+    if (it != acked_transfers_.end()) {
+        int next = 0;
+        unacked = it->second.received.missingRanges(0, static_cast<size_t>(-1), next);
+        tracked = it->second.received.size();
+        // 只保留[0, totalChunks)范围内的部分
+        while (!unacked.empty() && unacked.back().first >= totalChunks) {
+            unacked.pop_back();
+        }
+        if (!unacked.empty() && unacked.back().first + unacked.back().count > totalChunks) {
+            unacked.back().count = totalChunks - unacked.back().first;
+        }
+    }
+    // 本地位图之外的块一律视为未确认
+    if (tracked < totalChunks) {
+        if (!unacked.empty() && unacked.back().first + unacked.back().count == tracked) {
+            unacked.back().count += totalChunks - tracked;
+        } else {
+            unacked.push_back({tracked, totalChunks - tracked});
+        }
+    }
+    return unacked;
+}
+
+int ClientDBus::GetAckedChunks(const std::string& transferId) {
+    std::lock_guard<std::mutex> lock(ack_mutex_);
+    auto it = acked_transfers_.find(transferId);
+    return it != acked_transfers_.end() ? it->second.received.count() : 0;
+}
+
+uint32_t ClientDBus::GetAckCredit(const std::string& transferId) {
+    std::lock_guard<std::mutex> lock(ack_mutex_);
+    auto it = acked_transfers_.find(transferId);
+    return it != acked_transfers_.end() ? it->second.credit : 0;
+}
+
+void ClientDBus::ForgetTransferAcks(const std::string& transferId) {
+    {
+        std::lock_guard<std::mutex> lock(ack_mutex_);
+        acked_transfers_.erase(transferId);
+    }
+    ack_cv_.notify_all();
+}
+
 // 心跳检测工作线程
 void ClientDBus::heartbeat_worker() {
     std::cout << "[ClientDBus] 心跳检测线程启动，间隔: " << heartbeat_interval_ << "秒" << std::endl;
@@ -1167,8 +2160,13 @@ void ClientDBus::heartbeat_worker() {
             continue;
         }
         
-        // 检查连接是否真正可用
-        if (!is_connected()) {
+        // 服务已下线时等待服务名重新出现，无需探测
+        if (!service_available_) {
+            continue;
+        }
+        
+        // 检查服务是否仍在响应
+        if (!ping(1000)) {
             std::cout << "[ClientDBus] 心跳检测: 连接已断开" << std::endl;
             
             // 手动触发连接断开处理
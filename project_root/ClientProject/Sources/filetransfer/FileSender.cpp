@@ -11,16 +11,21 @@
 #include <atomic>
 #include <chrono>
 #include <iomanip>
+#include <algorithm>
 #include "FileTransfer.h"
 #include "FileSender.h"
 #include "ThreadPool.h"
 #include "ClientDBus.h"
+#include "ShmRing.h"
 #include <unordered_map>
 #include <condition_variable>
 
 // 全局实例
 static std::unique_ptr<ThreadPool> thread_pool_;
 static ClientDBus* dbus_client_ = nullptr;
+static std::atomic<SendMode> send_mode_{SendMode::Batch};
+static std::atomic<size_t> inflight_window_{DEFAULT_INFLIGHT_BYTES};
+static std::atomic<uint32_t> chunk_size_{DEFAULT_CHUNK_SIZE};
 
 // 文件描述符限制管理
 static const int MAX_CONCURRENT_FILES = 100; // 最大并发文件数
@@ -89,42 +94,334 @@ void wait_for_connection() {
     }
 }
 
-// 发送单个文件块到服务端
-void send_file_chunk(const FileChunk& chunk) {
-    // 调用DBus客户端发送文件块
+// 更新文件发送进度
+static void update_progress(const std::string& filepath, int chunk_count) {
+    std::lock_guard<std::mutex> lock(progress_mutex_);
+    auto counter_it = progress_counters_.find(filepath);
+    if (counter_it != progress_counters_.end()) {
+        int completed = (counter_it->second += chunk_count);
+
+        auto tracker_it = progress_trackers_.find(filepath);
+        if (tracker_it != progress_trackers_.end()) {
+            show_progress(filepath, completed, tracker_it->second.total_chunks);
+        }
+    }
+}
+
+// 读取[first_index, first_index + chunk_count)范围内的文件块
+static bool read_file_batch(int fd, const std::string& filepath, int first_index, int chunk_count, int total_chunks,
+                            const std::string& userid, mode_t mode, uint64_t file_length, const std::string& transferId,
+                            std::vector<FileChunk>& batch) {
+    batch.clear();
+    batch.reserve(chunk_count);
+
+    for (int chunk_index = first_index; chunk_index < first_index + chunk_count; ++chunk_index) {
+        // 直接使用FileChunk结构体，避免不必要的内存池中转
+        batch.emplace_back(userid, chunk_index, total_chunks, filepath, file_length, transferId,
+                           mode, chunk_index == total_chunks - 1);
+        FileChunk& chunk = batch.back();
+
+        // 直接读取文件数据到chunk.data
+        off_t offset = static_cast<off_t>(chunk_index) * FILE_CHUNK_SIZE;
+        ssize_t read_len = pread(fd, chunk.data, sizeof(chunk.data), offset);
+        if (read_len < 0) {
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            std::cerr << "[FileSender] 文件读取失败: " << filepath << std::endl;
+            return false;
+        }
+        chunk.chunkLength = read_len;
+    }
+    return true;
+}
+
+// 读取会话传输的一批块：[first_index, first_index + chunk_count)，按协商块大小连续存放
+static bool read_chunk_batch(int fd, const std::string& filepath, int first_index, int chunk_count,
+                             uint32_t chunk_size, uint64_t file_length, ChunkBatch& batch) {
+    batch.chunkSize = chunk_size;
+    batch.indices.resize(chunk_count);
+    batch.lengths.resize(chunk_count);
+
+    off_t first_offset = static_cast<off_t>(first_index) * chunk_size;
+    size_t length = std::min<size_t>(static_cast<size_t>(chunk_count) * chunk_size, file_length - first_offset);
+    batch.data.resize(length);
+
+    // 连续的块一次读入
+    size_t filled = 0;
+    while (filled < length) {
+        ssize_t n = pread(fd, batch.data.data() + filled, length - filled, first_offset + filled);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            std::cerr << "[FileSender] 文件读取失败: " << filepath << std::endl;
+            return false;
+        }
+        filled += n;
+    }
+
+    for (int i = 0; i < chunk_count; ++i) {
+        batch.indices[i] = first_index + i;
+        batch.lengths[i] = static_cast<uint32_t>(std::min<size_t>(chunk_size, length - static_cast<size_t>(i) * chunk_size));
+    }
+    return true;
+}
+
+// 单个文件的在途窗口：限制已发出但未应答的块数，失败的批次放回重试队列。
+// credit_chunks是服务端最近授予的额度（按块计），实际窗口取本地上限和额度的较小值
+struct InflightWindow {
+    struct Batch {
+        int first_index;
+        int chunk_count;
+        int attempts;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    int inflight_chunks{0};
+    int credit_chunks{0};
+    std::vector<Batch> retry_queue;
+};
+
+// 批量编组模式发送整个文件：异步发出批次，在途块数不超过窗口，应答回调中统计进度或安排重试
+static void send_file_pipelined(const std::string& filepath, const std::string& userid, mode_t mode,
+                                uint64_t file_length, int total_chunks, const std::string& transferId) {
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        std::cerr << "[FileSender] 无法打开文件: " << filepath << std::endl;
+        return;
+    }
+
+    // 登记传输会话并协商块大小，之后的批次只携带句柄和块索引；
+    // 服务端不支持会话时句柄为0，按FILE_CHUNK_SIZE带元数据发送
+    const FileChunk meta(userid, 0, total_chunks, filepath, file_length, transferId, mode);
+    TransferSession session;
+    if (dbus_client_) {
+        session = dbus_client_->OpenTransfer(meta, chunk_size_);
+    }
+    const bool use_session = (session.handle != 0);
+    const uint32_t chunk_size = use_session ? session.chunkSize : FILE_CHUNK_SIZE;
+    if (use_session) {
+        total_chunks = session.totalChunks;
+        std::lock_guard<std::mutex> lock(progress_mutex_);
+        auto tracker_it = progress_trackers_.find(filepath);
+        if (tracker_it != progress_trackers_.end()) {
+            tracker_it->second.total_chunks = total_chunks;
+        }
+    }
+
+    const int max_retries = 10;
+    const int batch_size = chunks_per_batch(chunk_size);
+    const int window = std::max(static_cast<int>(inflight_window_.load() / chunk_size), batch_size);
+    auto state = std::make_shared<InflightWindow>();
+    // 会话模式按服务端额度限制在途量，旧服务端没有额度时只受本地窗口限制
+    state->credit_chunks = use_session ? static_cast<int>(session.credit / chunk_size) : window;
+    std::vector<FileChunk> batch;
+    ChunkBatch session_batch;
+    int next_index = 0;
+
+    while (true) {
+        InflightWindow::Batch job;
+        {
+            // 等待窗口有空位，或有失败批次需要重发；额度耗尽时仍保留一个批次在途，应答会带回新的额度
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->cv.wait(lock, [&]() {
+                int limit = std::max(std::min(window, state->credit_chunks), batch_size);
+                return !state->retry_queue.empty() ||
+                       (next_index < total_chunks && state->inflight_chunks + batch_size <= limit) ||
+                       (next_index >= total_chunks && state->inflight_chunks == 0);
+            });
+
+            if (!state->retry_queue.empty()) {
+                job = state->retry_queue.back();
+                state->retry_queue.pop_back();
+            } else if (next_index < total_chunks) {
+                job = {next_index, std::min(batch_size, total_chunks - next_index), 0};
+                next_index += job.chunk_count;
+            } else {
+                break;
+            }
+            state->inflight_chunks += job.chunk_count;
+        }
+
+        if (job.attempts > 0) {
+            // 重发前等待连接恢复，并重新登记会话（服务端重启后旧句柄失效，同一传输重复登记返回原句柄）
+            wait_for_connection();
+            std::this_thread::sleep_for(std::chrono::seconds(2));
+            if (use_session && dbus_client_) {
+                TransferSession reopened = dbus_client_->OpenTransfer(meta, chunk_size);
+                if (reopened.handle != 0 && reopened.chunkSize == chunk_size) {
+                    session.handle = reopened.handle;
+                }
+            }
+        }
+
+        bool ready = dbus_client_ &&
+            (use_session ? read_chunk_batch(fd, filepath, job.first_index, job.chunk_count, chunk_size,
+                                            file_length, session_batch)
+                         : read_file_batch(fd, filepath, job.first_index, job.chunk_count, total_chunks,
+                                           userid, mode, file_length, transferId, batch));
+        if (!ready) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->inflight_chunks -= job.chunk_count;
+            std::cerr << "[FileSender] 放弃批次: 起始块 " << job.first_index << std::endl;
+            continue;
+        }
+
+        ClientDBus::CreditCallback done = [state, job, filepath, max_retries, use_session, chunk_size](bool ok, uint32_t credit) {
+            if (ok) {
+                update_progress(filepath, job.chunk_count);
+            }
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->inflight_chunks -= job.chunk_count;
+            if (use_session) {
+                state->credit_chunks = static_cast<int>(credit / chunk_size);
+            }
+            if (!ok) {
+                if (job.attempts + 1 < max_retries) {
+                    state->retry_queue.push_back({job.first_index, job.chunk_count, job.attempts + 1});
+                } else {
+                    std::lock_guard<std::mutex> error_lock(error_mutex_);
+                    std::cerr << "[FileSender] 发送文件块批次失败，已达到最大重试次数" << std::endl;
+                }
+            }
+            state->cv.notify_one();
+        };
+
+        if (use_session) {
+            dbus_client_->SendSessionChunksAsync(session.handle, std::move(session_batch), std::move(done));
+        } else {
+            dbus_client_->SendFileChunksAsync(std::move(batch), [done](bool ok) { done(ok, 0); });
+        }
+    }
+
+    // 传输完成时服务端已自动释放会话，这里只处理未完成的情况
+    if (dbus_client_ && use_session) {
+        dbus_client_->CloseTransfer(session.handle);
+    }
+    if (dbus_client_) {
+        dbus_client_->ForgetTransferAcks(transferId);
+    }
+    close(fd);
+}
+
+// 流式模式发送整个文件：块不等待逐批应答，在途量由服务端推送的确认和额度限制；
+// 每轮结束后按本地确认位图只重传缺口，服务端不支持会话时回退到批量编组模式
+static void send_file_streaming(const std::string& filepath, const std::string& userid, mode_t mode,
+                                uint64_t file_length, int total_chunks, const std::string& transferId) {
+    const FileChunk meta(userid, 0, total_chunks, filepath, file_length, transferId, mode);
+    TransferSession session;
     if (dbus_client_) {
-        // 等待连接可用
         wait_for_connection();
-        
-        // 尝试发送文件块，如果失败则等待重连
-        int max_retries = 10; 
-        int retry_count = 0;
-        
-        while (retry_count < max_retries) {
-            if (dbus_client_->SendFileChunk(chunk)) {
-                // 发送成功
+        session = dbus_client_->OpenTransfer(meta, chunk_size_);
+    }
+    if (session.handle == 0) {
+        if (dbus_client_) {
+            dbus_client_->ForgetTransferAcks(transferId);
+        }
+        send_file_pipelined(filepath, userid, mode, file_length, total_chunks, transferId);
+        return;
+    }
+
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        std::cerr << "[FileSender] 无法打开文件: " << filepath << std::endl;
+        dbus_client_->CloseTransfer(session.handle);
+        dbus_client_->ForgetTransferAcks(transferId);
+        return;
+    }
+
+    const uint32_t chunk_size = session.chunkSize;
+    total_chunks = session.totalChunks;
+    {
+        std::lock_guard<std::mutex> lock(progress_mutex_);
+        auto tracker_it = progress_trackers_.find(filepath);
+        if (tracker_it != progress_trackers_.end()) {
+            tracker_it->second.total_chunks = total_chunks;
+        }
+    }
+
+    const int max_rounds = 10;
+    const int batch_size = chunks_per_batch(chunk_size);
+    const int window = std::max(static_cast<int>(inflight_window_.load() / chunk_size), batch_size);
+    ChunkBatch batch;
+    int reported = 0;
+    bool completed = false;
+
+    // 进度按服务端确认的块数统计
+    auto report_progress = [&]() {
+        int acked = dbus_client_->GetAckedChunks(transferId);
+        if (acked > reported) {
+            update_progress(filepath, acked - reported);
+            reported = acked;
+        }
+    };
+
+    // 打开会话后服务端推送已接收集合，同一传输重发时跳过已收到的块
+    dbus_client_->WaitForAckSnapshot(transferId, SACK_TIMEOUT_MS);
+
+    for (int round = 0; round < max_rounds && !completed; ++round) {
+        std::vector<ChunkRange> pending = dbus_client_->GetUnackedRanges(transferId, total_chunks);
+        const int acked_base = dbus_client_->GetAckedChunks(transferId);
+        int sent = 0;
+        size_t range_pos = 0;
+        int next_index = pending.empty() ? 0 : pending.front().first;
+
+        while (range_pos < pending.size()) {
+            // 从未确认范围中切出一段不超过一个批次的连续块，一次读入
+            const ChunkRange& range = pending[range_pos];
+            int first_index = next_index;
+            int chunk_count = std::min(batch_size, range.first + range.count - first_index);
+            next_index += chunk_count;
+            if (next_index >= range.first + range.count && ++range_pos < pending.size()) {
+                next_index = pending[range_pos].first;
+            }
+
+            // 在途（已发出未确认）块数不超过本地窗口和服务端额度，额度耗尽时至少保留一个批次在途
+            int credit_chunks = static_cast<int>(dbus_client_->GetAckCredit(transferId) / chunk_size);
+            int limit = std::max(std::min(window, credit_chunks), batch_size);
+            if (sent + chunk_count - (dbus_client_->GetAckedChunks(transferId) - acked_base) > limit) {
+                dbus_client_->WaitForAcks(transferId, acked_base + sent + chunk_count - limit, SACK_TIMEOUT_MS);
+            }
+            report_progress();
+
+            if (!read_chunk_batch(fd, filepath, first_index, chunk_count, chunk_size, file_length, batch)) {
+                continue;
+            }
+            if (!dbus_client_->StreamSessionChunks(session.handle, batch)) {
                 break;
-            } else {
-                // 发送失败，等待重连
-                retry_count++;
-                
-                // 等待2秒后重试
-                std::this_thread::sleep_for(std::chrono::seconds(2));
             }
+            sent += chunk_count;
         }
-        
-        if (retry_count >= max_retries) {
-            std::cerr << "[FileSender] 发送文件块失败，已达到最大重试次数" << std::endl;
+
+        // 等待本轮的确认；仍有缺口时等待连接恢复并重新打开会话，用新的快照确定下一轮重传的块
+        completed = dbus_client_->WaitForAcks(transferId, total_chunks, SACK_TIMEOUT_MS);
+        if (!completed) {
+            wait_for_connection();
+            TransferSession reopened = dbus_client_->OpenTransfer(meta, chunk_size);
+            if (reopened.handle != 0 && reopened.chunkSize == chunk_size) {
+                session.handle = reopened.handle;
+                dbus_client_->WaitForAckSnapshot(transferId, SACK_TIMEOUT_MS);
+            }
         }
-    } else {
-        std::cerr << "[FileSender] DBus客户端未初始化，无法发送文件块" << std::endl;
     }
+    report_progress();
+
+    if (!completed) {
+        std::lock_guard<std::mutex> error_lock(error_mutex_);
+        std::cerr << "[FileSender] 流式发送未完成，已达到最大重传轮数: " << filepath << std::endl;
+    }
+
+    // 传输完成时服务端已自动释放会话，这里只处理未完成的情况
+    dbus_client_->CloseTransfer(session.handle);
+    dbus_client_->ForgetTransferAcks(transferId);
+    close(fd);
 }
 
-// 处理文件块的线程函数
-void process_file_chunk(const std::string& filepath, off_t offset, int chunk_index, int total_chunks, 
-                       const std::string& userid, mode_t mode, int file_length, const std::string& transferId) {
-    // 每个线程打开自己的文件描述符，避免竞争条件
+// FD传递模式：把源文件的[first_index, first_index + chunk_count)范围交给服务端直接拷贝
+void process_file_range(const std::string& filepath, int first_index, int chunk_count, int total_chunks,
+                        const std::string& userid, mode_t mode, uint64_t file_length, const std::string& transferId) {
     int fd = open(filepath.c_str(), O_RDONLY);
     if (fd < 0) {
         {
@@ -134,76 +431,140 @@ void process_file_chunk(const std::string& filepath, off_t offset, int chunk_ind
         return;
     }
 
-    // 直接使用FileChunk结构体，避免不必要的内存池中转
-    FileChunk chunk{}; 
-    
-    // 设置文件块信息
-    chunk.fileIndex = chunk_index;
-    chunk.totalChunks = total_chunks;
-    chunk.fileLength = file_length;
-    chunk.fileMode = mode;
-    chunk.isLastChunk = (chunk_index == total_chunks - 1);
-    
-    // 安全复制字符串
-    strncpy(chunk.userid, userid.c_str(), sizeof(chunk.userid) - 1);
-    chunk.userid[sizeof(chunk.userid) - 1] = '\0';
-    strncpy(chunk.fileName, filepath.c_str(), sizeof(chunk.fileName) - 1);
-    chunk.fileName[sizeof(chunk.fileName) - 1] = '\0';
-    
-    // 设置传输ID
-    if (!transferId.empty()) {
-        strncpy(chunk.transferId, transferId.c_str(), sizeof(chunk.transferId) - 1);
-        chunk.transferId[sizeof(chunk.transferId) - 1] = '\0';
+    FileChunk meta(userid, first_index, total_chunks, filepath, file_length, transferId, mode);
+    uint64_t offset = static_cast<uint64_t>(first_index) * FILE_CHUNK_SIZE;
+    uint64_t length = std::min<uint64_t>(static_cast<uint64_t>(chunk_count) * FILE_CHUNK_SIZE, file_length - offset);
+
+    if (dbus_client_) {
+        wait_for_connection();
+
+        int max_retries = 10;
+        int retry_count = 0;
+        while (retry_count < max_retries && !dbus_client_->SendFileRange(fd, offset, length, meta)) {
+            retry_count++;
+            std::this_thread::sleep_for(std::chrono::seconds(2));
+        }
+
+        if (retry_count >= max_retries) {
+            std::cerr << "[FileSender] 发送文件范围失败，已达到最大重试次数" << std::endl;
+        }
     } else {
-        chunk.transferId[0] = '\0'; // 清空传输ID
+        std::cerr << "[FileSender] DBus客户端未初始化，无法发送文件范围" << std::endl;
     }
 
-    // std::cout << "[FileSender] 发送文件块: " << chunk.fileName
-    //           << ", 索引: " << chunk.fileIndex
-    //           << ", 大小: " << chunk.chunkLength
-    //           << ", 传输ID: " << (chunk.transferId[0] ? chunk.transferId : "无") << std::endl;
+    close(fd);
 
-    // 直接读取文件数据到chunk.data
-    lseek(fd, offset, SEEK_SET);
-    int read_len = read(fd, chunk.data, sizeof(chunk.data));
-    if (read_len < 0) {
+    // 更新进度
+    update_progress(filepath, chunk_count);
+}
+
+// 共享内存模式：把[first_index, first_index + chunk_count)范围的文件数据直接读入环形缓冲区的槽位
+void process_file_slot(ShmRing* ring, const std::string& filepath, int first_index, int chunk_count,
+                       uint64_t file_length) {
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
         {
             std::lock_guard<std::mutex> lock(error_mutex_);
-            std::cerr << "[FileSender] 文件读取失败: " << filepath << std::endl;
+            std::cerr << "[FileSender] 无法打开文件: " << filepath << std::endl;
         }
-        close(fd);
         return;
     }
-    chunk.chunkLength = read_len;
 
-    // 发送文件块
-    send_file_chunk(chunk);
-    
-    // 关闭文件描述符
+    off_t offset = static_cast<off_t>(first_index) * FILE_CHUNK_SIZE;
+    size_t length = std::min<size_t>(static_cast<size_t>(chunk_count) * FILE_CHUNK_SIZE, file_length - offset);
+
+    // 环满时等待服务端消费，超时后重试
+    ShmSlot slot;
+    while (!ring->acquire(slot, 5000)) {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        std::cerr << "[FileSender] 等待共享内存槽位超时，继续等待..." << std::endl;
+    }
+
+    // 文件数据直接读入共享内存，不经过中间缓冲
+    size_t filled = 0;
+    while (filled < length) {
+        ssize_t n = pread(fd, slot.data + filled, length - filled, offset + filled);
+        if (n <= 0) {
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            std::cerr << "[FileSender] 文件读取失败: " << filepath << std::endl;
+            break;
+        }
+        filled += n;
+    }
     close(fd);
-    
+
+    ring->publish(slot, first_index, filled);
+
     // 更新进度
-    {
-        std::lock_guard<std::mutex> lock(progress_mutex_);
-        auto counter_it = progress_counters_.find(filepath);
-        if (counter_it != progress_counters_.end()) {
-            int completed = ++counter_it->second;
-            
-            // 每10个块或最后一个块显示进度
-            if (completed % 10 == 0 || completed == total_chunks) {
-                auto tracker_it = progress_trackers_.find(filepath);
-                if (tracker_it != progress_trackers_.end()) {
-                    show_progress(filepath, completed, tracker_it->second.total_chunks);
-                }
-            }
-        }
+    update_progress(filepath, chunk_count);
+}
+
+// 共享内存模式发送整个文件：建立环形缓冲区通道，线程池并发填充槽位，最后提交
+static void send_file_shm(const std::string& filepath, const std::string& userid, mode_t mode,
+                          uint64_t file_length, int total_chunks, const std::string& transferId) {
+    std::unique_ptr<ShmRing> ring = ShmRing::create();
+    if (!ring) {
+        std::cerr << "[FileSender] 创建共享内存环失败" << std::endl;
+        return;
+    }
+
+    wait_for_connection();
+    FileChunk meta(userid, 0, total_chunks, filepath, file_length, transferId, mode);
+    if (!dbus_client_ || !dbus_client_->OpenShmTransfer(*ring, meta)) {
+        std::cerr << "[FileSender] 建立共享内存传输通道失败: " << filepath << std::endl;
+        return;
     }
+
+    const int slot_chunks = ring->slot_size() / FILE_CHUNK_SIZE;
+    std::vector<std::future<void>> futures;
+    futures.reserve((total_chunks + slot_chunks - 1) / slot_chunks);
+
+    for (int first = 0; first < total_chunks; first += slot_chunks) {
+        int count = std::min(slot_chunks, total_chunks - first);
+        futures.push_back(thread_pool_->enqueue(process_file_slot, ring.get(), std::string(filepath),
+                                                first, count, file_length));
+    }
+
+    for (auto& future : futures) {
+        future.get();
+    }
+
+    // 所有槽位已发布，关闭环并通知服务端
+    ring->close();
+    if (!dbus_client_->CommitShmTransfer(transferId)) {
+        std::cerr << "[FileSender] 提交共享内存传输失败: " << filepath << std::endl;
+    }
+}
+
+// 设置文件数据的发送方式
+void set_send_mode(SendMode mode) {
+    send_mode_ = mode;
+    const char* name = (mode == SendMode::FdPassing) ? "FD传递" :
+                       (mode == SendMode::SharedMemory) ? "共享内存" :
+                       (mode == SendMode::Streaming) ? "流式选择性确认" : "批量编组";
+    std::cout << "[FileSender] 发送方式: " << name << std::endl;
+}
+
+// 设置批量编组模式下每个文件的在途字节数上限
+void set_inflight_window(size_t max_bytes) {
+    inflight_window_ = max_bytes;
+    std::cout << "[FileSender] 在途窗口: " << max_bytes << " 字节" << std::endl;
+}
+
+// 设置批量编组模式请求的块大小
+void set_chunk_size(uint32_t chunk_size) {
+    chunk_size_ = chunk_size;
+    std::cout << "[FileSender] 请求块大小: " << chunk_size << " 字节" << std::endl;
 }
 
 // 设置DBus客户端实例
 void set_dbus_client(ClientDBus* dbus_client) {
     dbus_client_ = dbus_client;
     if (dbus_client_) {
+        // 连接状态变化时唤醒等待连接恢复的发送线程
+        dbus_client_->add_connection_callback([](bool) {
+            connection_cv_.notify_all();
+        });
         std::cout << "[FileSender] DBus客户端已设置，连接状态: " 
                   << (dbus_client_->is_connected() ? "已连接" : "未连接") << std::endl;
     } else {
@@ -283,31 +644,42 @@ void send_file(const std::string& filepath, const std::string& userid, mode_t mo
         progress_counters_[filepath] = 0;
     }
 
-    // 使用线程池并发发送所有文件块
-    std::vector<std::future<void>> futures;
-    futures.reserve(total_chunks);
+    const SendMode send_mode = send_mode_;
+    if (send_mode == SendMode::SharedMemory) {
+        // 共享内存模式：数据经环形缓冲区传输
+        send_file_shm(filepath, userid, mode, static_cast<uint64_t>(file_length), total_chunks, transferId);
+    } else if (send_mode == SendMode::Streaming) {
+        // 流式模式：不等待逐批应答，按服务端推送的确认重传缺口
+        send_file_streaming(filepath, userid, mode, static_cast<uint64_t>(file_length), total_chunks, transferId);
+    } else if (send_mode == SendMode::Batch) {
+        // 批量编组模式：异步流水线发送，由在途窗口限流
+        send_file_pipelined(filepath, userid, mode, static_cast<uint64_t>(file_length), total_chunks, transferId);
+    } else {
+        // FD传递模式：按范围切分，使用线程池并发发送
+        const int range_chunks = FD_RANGE_BYTES / FILE_CHUNK_SIZE;
+        std::vector<std::future<void>> futures;
+        futures.reserve((total_chunks + range_chunks - 1) / range_chunks);
 
-    // std::cout << "[send_file] filemode:" << mode << std::endl;
+        for (int first = 0; first < total_chunks; first += range_chunks) {
+            int count = std::min(range_chunks, total_chunks - first);
+            
+            // 使用线程池提交任务
+            auto future = thread_pool_->enqueue(process_file_range, 
+                                               std::string(filepath), 
+                                               first, 
+                                               count, 
+                                               total_chunks, 
+                                               std::string(userid), 
+                                               mode, 
+                                               static_cast<uint64_t>(file_length),
+                                               std::string(transferId));
+            futures.push_back(std::move(future));
+        }
 
-    for (int i = 0; i < total_chunks; ++i) {
-        off_t offset = i * FILE_CHUNK_SIZE;
-        
-        // 使用线程池提交任务
-        auto future = thread_pool_->enqueue(process_file_chunk, 
-                                           std::string(filepath), 
-                                           offset, 
-                                           i, 
-                                           total_chunks, 
-                                           std::string(userid), 
-                                           mode, 
-                                           static_cast<int>(file_length),
-                                           std::string(transferId));
-        futures.push_back(std::move(future));
-    }
-
-    // 等待所有任务完成
-    for (auto& future : futures) {
-        future.get();
+        // 等待所有任务完成
+        for (auto& future : futures) {
+            future.get();
+        }
     }
 
     // 清理进度跟踪器
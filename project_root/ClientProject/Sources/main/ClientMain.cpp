@@ -341,26 +341,29 @@ void gain_transferStatus_missblock() {
     size_t lastSlash = videoPath.find_last_of('/');
     std::string fileName = (lastSlash != std::string::npos) ? videoPath.substr(lastSlash + 1) : videoPath;
     
-    // 测试获取传输状态
+    // 测试获取传输状态：状态和已接收位图一次取回
     std::cout << "\n--- 测试获取传输状态 ---" << std::endl;
-    TransferStatus status = client.GetTransferStatus(transferId, userId, fileName);
+    TransferStatus status = client.GetTransferSnapshot(transferId, userId, fileName);
     std::cout << "传输状态: 总块数=" << status.totalChunks 
               << ", 已接收块数=" << status.receivedChunks
               << ", 文件长度=" << status.fileLength
               << ", 已接收长度=" << status.receivedLength
               << ", 状态码=" << status.statusCode
-              << ", 是否完成=" << (status.isCompleted ? "是" : "否") << std::endl;
+              << ", 是否完成=" << (status.isCompleted ? "是" : "否")
+              << ", 开始时间=" << status.startTime
+              << ", 最后更新时间=" << status.lastUpdateTime << std::endl;
     
-    // 测试获取缺失块列表
+    // 缺失块由位图在本地计算，不再单独调用GetMissingChunks
     std::cout << "\n--- 测试获取缺失块列表 ---" << std::endl;
-    std::vector<int> missingChunks = client.GetMissingChunks(transferId, userId, fileName);
-    std::cout << "缺失块总数: " << missingChunks.size() << std::endl;
+    int next = 0;
+    std::vector<ChunkRange> missingRanges = status.getMissingRanges(0, status.totalChunks, next);
+    std::cout << "缺失范围总数: " << missingRanges.size() << std::endl;
     
-    if (!missingChunks.empty()) {
-        std::cout << "缺失块索引: ";
-        for (size_t i = 0; i < missingChunks.size(); i++) {
-            std::cout << missingChunks[i];
-            if (i < missingChunks.size() - 1) {
+    if (!missingRanges.empty()) {
+        std::cout << "缺失块范围: ";
+        for (size_t i = 0; i < missingRanges.size(); i++) {
+            std::cout << missingRanges[i].first << "-" << (missingRanges[i].first + missingRanges[i].count - 1);
+            if (i < missingRanges.size() - 1) {
                 std::cout << ", ";
             }
         }
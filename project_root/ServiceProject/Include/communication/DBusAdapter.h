@@ -1,6 +1,15 @@
 #pragma once
 #include "ITestService.h"
 #include <gio/gio.h>
+#include <string>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+class ThreadPool;
 
 class DBusAdapter {
 public:
@@ -11,12 +20,26 @@ public:
     void runLoop();
     ITestService* getTestService() const { return test_service_; }
 
+    // 是否启动点对点监听（需在init之前设置），关闭后客户端只能经总线守护进程通信
+    void enablePeerListener(bool enable) { peer_enabled_ = enable; }
+    // 点对点监听的客户端地址，未启动时为空
+    const std::string& getPeerAddress() const { return peer_address_; }
+    // 方法分派线程数（需在init之前设置）：0表示全部在主循环处理；
+    // N>0时每个线程运行独立的GMainContext，点对点连接按连接分配，总线上的调用按发送者分配
+    void setDispatchThreads(int count) { dispatch_thread_count_ = count > 0 ? count : 0; }
+
     // D-Bus信号广播接口声明
     void emitTestBoolChanged(bool value);
     void emitTestIntChanged(int value);
     void emitTestDoubleChanged(double value);
     void emitTestStringChanged(const std::string& value);
     void emitTestInfoChanged(const TestInfo& info);
+    // 选择性确认：推送一个传输已接收的块范围和当前额度，只发给打开该传输的客户端
+    void emitChunksAcked(const ChunkAck& ack);
+    // 记录确认的投递目标：打开传输的连接和发送者唯一名（点对点连接上为空），重复打开时替换
+    void setChunkAckRoute(const std::string& transferId, uint32_t handle, GDBusConnection* connection, const char* sender);
+    // 关闭会话后不再投递该句柄对应传输的确认
+    void dropChunkAckRoute(uint32_t handle);
 private:
     ITestService* test_service_;
     GMainLoop* main_loop_ = nullptr;
@@ -25,6 +48,50 @@ private:
     guint name_owner_id_;
     GDBusConnection* connection_;
 
+    // Offload方法的工作线程池，避免耗时调用阻塞主循环上其他客户端的请求
+    std::unique_ptr<ThreadPool> worker_pool_;
+
+    // 点对点监听：客户端通过GetPeerAddress获取地址后直连，批量数据不再经过总线守护进程
+    bool peer_enabled_ = true;
+    GDBusServer* peer_server_ = nullptr;
+    GDBusAuthObserver* peer_auth_observer_ = nullptr;
+    std::string peer_address_;
+    std::map<GDBusConnection*, guint> peer_connections_; // 点对点连接 -> 对象注册ID（仅在主循环线程访问）
+
+    // 选择性确认的投递目标（持有连接引用），确认线程和方法分派线程都会访问
+    struct ChunkAckRoute {
+        GDBusConnection* connection = nullptr;
+        std::string sender;
+        uint32_t handle = 0;
+    };
+    std::map<std::string, ChunkAckRoute> ack_routes_; // 传输ID -> 投递目标
+    std::mutex ack_routes_mutex_;
+    void dropChunkAckRoutes(GDBusConnection* connection);
+
+    // 方法分派线程：各自独占一个GMainContext，连接上的方法调用在所属线程解码和处理
+    struct DispatchThread {
+        GMainContext* context = nullptr;
+        GMainLoop* loop = nullptr;
+        std::thread thread;
+    };
+    int dispatch_thread_count_ = 0;
+    std::vector<std::unique_ptr<DispatchThread>> dispatch_threads_;
+    std::atomic<size_t> next_dispatch_thread_{0};
+
+    void startDispatchThreads();
+    void stopDispatchThreads();
+    static void dispatch_method_call(DBusAdapter* adapter, const gchar* method_name,
+                                     GVariant* parameters, GDBusMethodInvocation* invocation);
+    static gboolean run_routed_method_call(gpointer user_data);
+
+    bool startPeerServer();
+    void stopPeerServer();
+    static gboolean on_new_peer_connection(GDBusServer* server, GDBusConnection* connection, gpointer user_data);
+    static void on_peer_connection_closed(GDBusConnection* connection, gboolean remote_peer_vanished,
+                                          GError* error, gpointer user_data);
+    static gboolean on_authorize_peer(GDBusAuthObserver* observer, GIOStream* stream,
+                                      GCredentials* credentials, gpointer user_data);
+
     static void handle_method_call(GDBusConnection* connection,
                                   const gchar* sender,
                                   const gchar* object_path,
@@ -20,7 +20,22 @@ public:
     virtual TestInfo GetTestInfo() = 0;
     // 文件传输接口
     virtual bool SendFileChunk(const FileChunk& chunk) = 0;
+    // 批量接收：负载以视图形式引用D-Bus消息，直到写入目标位置前不做拷贝
+    virtual bool SendFileChunks(const std::vector<ChunkView>& chunks) = 0;
+    // 传输会话接口：元数据只登记一次，之后的块只携带(句柄, 索引, 负载)
+    virtual TransferSession OpenTransfer(const FileChunk& meta, uint32_t chunkSize) = 0;
+    // credit返回服务端授予该传输的在途额度（字节），发送端据此限制在途数据量
+    virtual bool SendSessionChunks(uint32_t handle, const std::vector<ChunkView>& chunks, uint32_t& credit) = 0;
+    virtual bool CloseTransfer(uint32_t handle) = 0;
+    // FD传递接口：fd的所有权转移给服务端，meta.fileIndex为起始块索引
+    virtual bool SendFileRange(const FileChunk& meta, int fd, uint64_t offset, uint64_t length) = 0;
+    // 共享内存传输接口：D-Bus只传递环形缓冲区的描述符和开始/结束控制
+    virtual bool OpenShmTransfer(const FileChunk& meta, int mem_fd, int data_efd, int space_efd) = 0;
+    virtual bool CommitShmTransfer(const std::string& transferId) = 0;
     // 断点续传接口
     virtual TransferStatus GetTransferStatus(const std::string& transferId, const std::string& userid, const std::string& fileName) = 0;
     virtual std::vector<int> GetMissingChunks(const std::string& transferId, const std::string& userid, const std::string& fileName) = 0;
+    // 按会话分页获取缺失块范围，next为下一页起始块索引（已到末尾为0），句柄无效时返回false
+    virtual bool GetMissingRanges(uint32_t handle, uint32_t cursor, uint32_t limit,
+                                  std::vector<ChunkRange>& ranges, uint32_t& next) = 0;
 };
\ No newline at end of file
@@ -25,10 +25,19 @@ public:
     TestInfo GetTestInfo() override;
 
     bool SendFileChunk(const FileChunk& chunk) override;
+    bool SendFileChunks(const std::vector<ChunkView>& chunks) override;
+    TransferSession OpenTransfer(const FileChunk& meta, uint32_t chunkSize) override;
+    bool SendSessionChunks(uint32_t handle, const std::vector<ChunkView>& chunks, uint32_t& credit) override;
+    bool CloseTransfer(uint32_t handle) override;
+    bool SendFileRange(const FileChunk& meta, int fd, uint64_t offset, uint64_t length) override;
+    bool OpenShmTransfer(const FileChunk& meta, int mem_fd, int data_efd, int space_efd) override;
+    bool CommitShmTransfer(const std::string& transferId) override;
     
     // 断点续传接口
     TransferStatus GetTransferStatus(const std::string& transferId, const std::string& userid, const std::string& fileName) override;
     std::vector<int> GetMissingChunks(const std::string& transferId, const std::string& userid, const std::string& fileName) override;
+    bool GetMissingRanges(uint32_t handle, uint32_t cursor, uint32_t limit,
+                          std::vector<ChunkRange>& ranges, uint32_t& next) override;
 
     // 注册观察者
     void registerListener(ITestListener* listener);
@@ -43,6 +52,7 @@ private:
     void broadcastTestDoubleChanged(double param);
     void broadcastTestStringChanged(const std::string& param);
     void broadcastTestInfoChanged(const TestInfo& param);
+    void broadcastChunksAcked(const ChunkAck& ack);
 
     std::vector<ITestListener*> listeners_;  // 观察者列表
     std::mutex listener_mutex_;              // 观察者列表锁
@@ -3,19 +3,67 @@
 #include <sys/types.h>
 #include <map>
 #include <mutex>
+#include <cstdint>
+#include <functional>
 #include "FileTransfer.h"
 
-// 初始化文件接收器（创建线程池）
+// 选择性确认回调，在确认线程上调用，不能阻塞
+using ChunkAckCallback = std::function<void(const ChunkAck& ack)>;
+
+// 初始化文件接收器（创建线程池），并从传输日志恢复上次未完成的直写传输
 int init_file_receiver(size_t thread_pool_size = 0, size_t memory_pool_blocks = 100);
 
-// 清理文件接收器（释放线程池）
+// 停止选择性确认：清除回调并等待确认线程退出。回调经由TestService和DBusAdapter推送信号，
+// 必须在销毁它们之前调用
+void stop_chunk_acks();
+
+// 清理文件接收器（释放线程池），退出前提交最后一组传输日志。
+// 调用前需销毁DBusAdapter，保证不再有新的接收调用进入
 int cleanup_file_receiver();
 
 // 接收单个文件块
 int receive_file_chunk(const struct FileChunk& chunk, const std::string& outdir);
 
-// 处理文件块的线程函数
-void process_file_chunk(const struct FileChunk& chunk, const std::string& outdir);
+// 接收一批文件块视图，负载在写入目标文件（或进入缓存）前不做拷贝
+int receive_chunk_views(const std::vector<ChunkView>& views, const std::string& outdir);
+
+// 处理文件块视图的线程函数
+void process_chunk_views(const std::vector<ChunkView>& views, const std::string& outdir);
+
+// 打开传输会话：登记一次传输元数据并协商块大小（chunk_size为0时取默认值），
+// 返回紧凑的会话句柄（失败为0）、按协商块大小计算的总块数和初始在途额度，之后的块只需携带句柄和索引
+TransferSession open_transfer(const struct FileChunk& meta, uint32_t chunk_size, const std::string& outdir);
+
+// 关闭传输会话（只释放句柄，已接收的状态保留）
+int close_transfer(uint32_t handle);
+
+// 按会话句柄接收一批文件块视图，视图的meta可为空。
+// 批次按内存预算准入，credit非空时返回服务端授予该传输的在途额度（字节），发送端据此限制在途数据量
+int receive_session_chunks(uint32_t handle, const std::vector<ChunkView>& views, uint32_t* credit = nullptr);
+
+// 接收FD传递的文件范围（meta.fileIndex为起始块索引），src_fd由接收器负责关闭
+int receive_file_range(const struct FileChunk& meta, int src_fd, off_t src_offset, size_t length, const std::string& outdir);
+
+// 处理文件范围的线程函数：copy_file_range直接拷贝到目标文件
+void process_file_range(const struct FileChunk& meta, int src_fd, off_t src_offset, size_t length, const std::string& outdir);
+
+// 建立共享内存传输通道（memfd环形缓冲区 + 数据/空间eventfd），描述符所有权转移给接收器
+int open_shm_transfer(const struct FileChunk& meta, int mem_fd, int data_efd, int space_efd, const std::string& outdir);
+
+// 结束共享内存传输通道，剩余槽位处理完后自动释放
+int commit_shm_transfer(const std::string& transferId);
+
+// 按会话句柄分页获取缺失块范围：从cursor开始最多limit个范围，next为下一页起始块索引（已到末尾为0）；
+// 句柄无效时返回-1
+int get_missing_ranges(uint32_t handle, int cursor, size_t limit, std::vector<ChunkRange>& ranges, int& next);
+
+// 设置直写模式（默认开启）：开启时块在第一次写入时即创建预分配的临时文件并按偏移直接写入，
+// 不在内存中缓存整个文件；关闭时块缓存在内存中，收齐后一次组装
+void set_direct_write(bool enable);
+
+// 设置选择性确认回调：接收器每隔SACK_INTERVAL_MS把各传输新收到的块范围合并为一个确认，
+// 打开会话后推送一次完整的已接收集合
+void set_chunk_ack_callback(ChunkAckCallback callback);
 
 // 获取线程池大小
 size_t get_receiver_thread_pool_size();
@@ -1,9 +1,23 @@
 #include "DBusAdapter.h"
 #include "FileTransfer.h"
+#include "ThreadPool.h"
+#include <gio/gunixfdlist.h>
 #include <iostream>
 #include <cstring>
-#include <unordered_map>
 #include <functional>
+#include <memory>
+#include <cstdint>
+#include <unistd.h>
+
+// 让文件块视图持有消息参数的引用，负载随消息存活直到最后一个视图释放
+static std::shared_ptr<const void> hold_variant(GVariant* variant) {
+    return std::shared_ptr<const void>(g_variant_ref(variant), [](const void* p) {
+        g_variant_unref(static_cast<GVariant*>(const_cast<void*>(p)));
+    });
+}
+
+// Offload方法工作线程数
+static const size_t DBUS_WORKER_THREADS = 4;
 
 // Service name for bus registration
 static const char* SERVICE_NAME = "com.example.TestService";
@@ -53,17 +67,90 @@ static const gchar introspection_xml[] =
     "      <arg type='i' name='fileIndex' direction='in'/>"
     "      <arg type='u' name='totalChunks' direction='in'/>"
     "      <arg type='i' name='chunkLength' direction='in'/>"
-    "      <arg type='i' name='fileLength' direction='in'/>"
+    "      <arg type='t' name='fileLength' direction='in'/>"
     "      <arg type='u' name='fileMode' direction='in'/>"
     "      <arg type='b' name='isLastChunk' direction='in'/>"
     "      <arg type='s' name='transferId' direction='in'/>"
     "      <arg type='b' name='result' direction='out'/>"
     "    </method>"
+    "    <method name='SendFileChunks'>"
+    "      <arg type='a(iay)' name='chunks' direction='in'/>"
+    "      <arg type='s' name='userid' direction='in'/>"
+    "      <arg type='s' name='fileName' direction='in'/>"
+    "      <arg type='u' name='totalChunks' direction='in'/>"
+    "      <arg type='t' name='fileLength' direction='in'/>"
+    "      <arg type='u' name='fileMode' direction='in'/>"
+    "      <arg type='s' name='transferId' direction='in'/>"
+    "      <arg type='b' name='result' direction='out'/>"
+    "    </method>"
+    "    <method name='OpenTransfer'>"
+    "      <arg type='s' name='userid' direction='in'/>"
+    "      <arg type='s' name='fileName' direction='in'/>"
+    "      <arg type='t' name='fileLength' direction='in'/>"
+    "      <arg type='u' name='fileMode' direction='in'/>"
+    "      <arg type='s' name='transferId' direction='in'/>"
+    "      <arg type='u' name='chunkSize' direction='in'/>"
+    "      <arg type='u' name='handle' direction='out'/>"
+    "      <arg type='u' name='chunkSize' direction='out'/>"
+    "      <arg type='u' name='totalChunks' direction='out'/>"
+    "      <arg type='u' name='credit' direction='out'/>"
+    "    </method>"
+    "    <method name='SendSessionChunks'>"
+    "      <arg type='u' name='handle' direction='in'/>"
+    "      <arg type='a(iay)' name='chunks' direction='in'/>"
+    "      <arg type='b' name='result' direction='out'/>"
+    "      <arg type='u' name='credit' direction='out'/>"
+    "    </method>"
+    "    <method name='CloseTransfer'>"
+    "      <arg type='u' name='handle' direction='in'/>"
+    "      <arg type='b' name='result' direction='out'/>"
+    "    </method>"
+    "    <method name='SendFileRange'>"
+    "      <arg type='h' name='fd' direction='in'/>"
+    "      <arg type='t' name='offset' direction='in'/>"
+    "      <arg type='t' name='length' direction='in'/>"
+    "      <arg type='i' name='firstIndex' direction='in'/>"
+    "      <arg type='s' name='userid' direction='in'/>"
+    "      <arg type='s' name='fileName' direction='in'/>"
+    "      <arg type='u' name='totalChunks' direction='in'/>"
+    "      <arg type='t' name='fileLength' direction='in'/>"
+    "      <arg type='u' name='fileMode' direction='in'/>"
+    "      <arg type='s' name='transferId' direction='in'/>"
+    "      <arg type='b' name='result' direction='out'/>"
+    "    </method>"
+    "    <method name='OpenShmTransfer'>"
+    "      <arg type='h' name='memFd' direction='in'/>"
+    "      <arg type='h' name='dataEventFd' direction='in'/>"
+    "      <arg type='h' name='spaceEventFd' direction='in'/>"
+    "      <arg type='s' name='userid' direction='in'/>"
+    "      <arg type='s' name='fileName' direction='in'/>"
+    "      <arg type='u' name='totalChunks' direction='in'/>"
+    "      <arg type='t' name='fileLength' direction='in'/>"
+    "      <arg type='u' name='fileMode' direction='in'/>"
+    "      <arg type='s' name='transferId' direction='in'/>"
+    "      <arg type='b' name='result' direction='out'/>"
+    "    </method>"
+    "    <method name='CommitShmTransfer'>"
+    "      <arg type='s' name='transferId' direction='in'/>"
+    "      <arg type='b' name='result' direction='out'/>"
+    "    </method>"
     "    <method name='GetTransferStatus'>"
     "      <arg type='s' name='transferId' direction='in'/>"
     "      <arg type='s' name='userid' direction='in'/>"
     "      <arg type='s' name='fileName' direction='in'/>"
-    "      <arg type='(sisiiuibtt)' name='status' direction='out'/>"
+    "      <arg type='(sisiittbtt)' name='status' direction='out'/>"
+    "    </method>"
+    "    <method name='GetTransferSnapshot'>"
+    "      <arg type='s' name='transferId' direction='in'/>"
+    "      <arg type='s' name='userid' direction='in'/>"
+    "      <arg type='s' name='fileName' direction='in'/>"
+    "      <arg type='(sisiittbtt)' name='status' direction='out'/>"
+    "      <arg type='y' name='encoding' direction='out'/>"
+    "      <arg type='ay' name='bitmap' direction='out'/>"
+    "    </method>"
+    "    <method name='Ping'/>"
+    "    <method name='GetPeerAddress'>"
+    "      <arg type='s' name='address' direction='out'/>"
     "    </method>"
     "    <method name='GetMissingChunks'>"
     "      <arg type='s' name='transferId' direction='in'/>"
@@ -71,6 +158,13 @@ static const gchar introspection_xml[] =
     "      <arg type='s' name='fileName' direction='in'/>"
     "      <arg type='ai' name='missingChunks' direction='out'/>"
     "    </method>"
+    "    <method name='GetMissingRanges'>"
+    "      <arg type='u' name='handle' direction='in'/>"
+    "      <arg type='u' name='cursor' direction='in'/>"
+    "      <arg type='u' name='limit' direction='in'/>"
+    "      <arg type='a(uu)' name='ranges' direction='out'/>"
+    "      <arg type='u' name='next' direction='out'/>"
+    "    </method>"
     "    <signal name='TestBoolChanged'>"
     "      <arg type='b' name='value'/>"
     "    </signal>"
@@ -86,6 +180,12 @@ static const gchar introspection_xml[] =
     "    <signal name='TestInfoChanged'>"
     "      <arg type='(bids)' name='info'/>"
     "    </signal>"
+    "    <signal name='ChunksAcked'>"
+    "      <arg type='s' name='transferId'/>"
+    "      <arg type='b' name='snapshot'/>"
+    "      <arg type='a(ii)' name='ranges'/>"
+    "      <arg type='u' name='credit'/>"
+    "    </signal>"
     "  </interface>"
     "</node>";
 
@@ -100,6 +200,16 @@ DBusAdapter::~DBusAdapter() {
         g_main_loop_unref(main_loop_);
         main_loop_ = nullptr;
     }
+
+    // 先停止分派线程，不再有新任务投递到工作线程池
+    stopDispatchThreads();
+
+    // 等待已投递的方法执行完毕并应答
+    worker_pool_.reset();
+
+    // 关闭点对点监听及已建立的点对点连接，释放确认投递目标持有的连接引用
+    stopPeerServer();
+    dropChunkAckRoutes(nullptr);
     
     // 注销D-Bus对象
     if (connection_ && registration_id_ != 0) {
@@ -141,6 +251,8 @@ bool DBusAdapter::init() {
     }
 
     introspection_data_ = g_dbus_node_info_new_for_xml(introspection_xml, nullptr);
+    worker_pool_ = std::make_unique<ThreadPool>(DBUS_WORKER_THREADS);
+    startDispatchThreads();
 
     GDBusInterfaceVTable vtable = {};
     vtable.method_call = handle_method_call;
@@ -168,9 +280,157 @@ bool DBusAdapter::init() {
         nullptr, nullptr, nullptr, nullptr
     );
     std::cout << "[DBusAdapter] GDBus service initialized successfully" << std::endl;
+
+    // 点对点监听失败不影响总线服务
+    if (peer_enabled_ && !startPeerServer()) {
+        std::cerr << "[DBusAdapter] 点对点监听启动失败，文件传输将经总线转发" << std::endl;
+    }
+    return true;
+}
+
+// 启动方法分派线程，每个线程在自己的GMainContext上运行主循环
+void DBusAdapter::startDispatchThreads() {
+    for (int i = 0; i < dispatch_thread_count_; ++i) {
+        auto dispatch = std::make_unique<DispatchThread>();
+        dispatch->context = g_main_context_new();
+        dispatch->loop = g_main_loop_new(dispatch->context, FALSE);
+        DispatchThread* raw = dispatch.get();
+        dispatch->thread = std::thread([raw]() {
+            g_main_context_push_thread_default(raw->context);
+            g_main_loop_run(raw->loop);
+            g_main_context_pop_thread_default(raw->context);
+        });
+        dispatch_threads_.push_back(std::move(dispatch));
+    }
+    if (!dispatch_threads_.empty()) {
+        std::cout << "[DBusAdapter] 方法分派线程数: " << dispatch_threads_.size() << std::endl;
+    }
+}
+
+void DBusAdapter::stopDispatchThreads() {
+    for (auto& dispatch : dispatch_threads_) {
+        g_main_loop_quit(dispatch->loop);
+        if (dispatch->thread.joinable()) {
+            dispatch->thread.join();
+        }
+        g_main_loop_unref(dispatch->loop);
+        g_main_context_unref(dispatch->context);
+    }
+    dispatch_threads_.clear();
+}
+
+// 在用户运行时目录下监听私有Unix套接字，只接受同一用户的连接
+bool DBusAdapter::startPeerServer() {
+    const gchar* runtime_dir = g_get_user_runtime_dir();
+    std::string listen_address = std::string("unix:dir=") + (runtime_dir ? runtime_dir : g_get_tmp_dir());
+
+    peer_auth_observer_ = g_dbus_auth_observer_new();
+    g_signal_connect(peer_auth_observer_, "authorize-authenticated-peer", G_CALLBACK(on_authorize_peer), this);
+
+    GError* error = nullptr;
+    gchar* guid = g_dbus_generate_guid();
+    peer_server_ = g_dbus_server_new_sync(listen_address.c_str(), G_DBUS_SERVER_FLAGS_NONE, guid,
+                                          peer_auth_observer_, nullptr, &error);
+    g_free(guid);
+    if (!peer_server_) {
+        std::cerr << "[DBusAdapter] 创建点对点监听失败: " << (error ? error->message : "unknown") << std::endl;
+        if (error) g_error_free(error);
+        g_object_unref(peer_auth_observer_);
+        peer_auth_observer_ = nullptr;
+        return false;
+    }
+
+    g_signal_connect(peer_server_, "new-connection", G_CALLBACK(on_new_peer_connection), this);
+    g_dbus_server_start(peer_server_);
+    peer_address_ = g_dbus_server_get_client_address(peer_server_);
+    std::cout << "[DBusAdapter] 点对点监听地址: " << peer_address_ << std::endl;
     return true;
 }
 
+void DBusAdapter::stopPeerServer() {
+    for (auto& entry : peer_connections_) {
+        g_signal_handlers_disconnect_by_data(entry.first, this);
+        g_dbus_connection_unregister_object(entry.first, entry.second);
+        g_dbus_connection_close_sync(entry.first, nullptr, nullptr);
+        g_object_unref(entry.first);
+    }
+    peer_connections_.clear();
+
+    if (peer_server_) {
+        g_dbus_server_stop(peer_server_);
+        g_object_unref(peer_server_);
+        peer_server_ = nullptr;
+    }
+    if (peer_auth_observer_) {
+        g_object_unref(peer_auth_observer_);
+        peer_auth_observer_ = nullptr;
+    }
+    peer_address_.clear();
+}
+
+// 新的点对点连接：在该连接上注册同一个服务对象
+gboolean DBusAdapter::on_new_peer_connection(GDBusServer* /*server*/, GDBusConnection* connection, gpointer user_data) {
+    DBusAdapter* adapter = static_cast<DBusAdapter*>(user_data);
+
+    // 开启分派线程时按连接轮流分配：注册时的线程默认上下文决定该连接上方法调用的处理线程
+    GMainContext* context = nullptr;
+    if (!adapter->dispatch_threads_.empty()) {
+        size_t index = adapter->next_dispatch_thread_++ % adapter->dispatch_threads_.size();
+        context = adapter->dispatch_threads_[index]->context;
+        g_main_context_push_thread_default(context);
+    }
+
+    GDBusInterfaceVTable vtable = {};
+    vtable.method_call = handle_method_call;
+    GError* error = nullptr;
+    guint registration_id = g_dbus_connection_register_object(
+        connection,
+        "/com/example/TestService",
+        adapter->introspection_data_->interfaces[0],
+        &vtable,
+        adapter,
+        nullptr, &error);
+    if (context) {
+        g_main_context_pop_thread_default(context);
+    }
+    if (registration_id == 0) {
+        std::cerr << "[DBusAdapter] 点对点连接注册对象失败: " << (error ? error->message : "unknown") << std::endl;
+        if (error) g_error_free(error);
+        return FALSE;
+    }
+
+    g_object_ref(connection);
+    adapter->peer_connections_[connection] = registration_id;
+    g_signal_connect(connection, "closed", G_CALLBACK(on_peer_connection_closed), adapter);
+    std::cout << "[DBusAdapter] 建立点对点连接，当前连接数: " << adapter->peer_connections_.size() << std::endl;
+    return TRUE;
+}
+
+void DBusAdapter::on_peer_connection_closed(GDBusConnection* connection, gboolean /*remote_peer_vanished*/,
+                                            GError* /*error*/, gpointer user_data) {
+    DBusAdapter* adapter = static_cast<DBusAdapter*>(user_data);
+    auto it = adapter->peer_connections_.find(connection);
+    if (it == adapter->peer_connections_.end()) {
+        return;
+    }
+
+    g_signal_handlers_disconnect_by_data(connection, adapter);
+    g_dbus_connection_unregister_object(connection, it->second);
+    adapter->peer_connections_.erase(it);
+    adapter->dropChunkAckRoutes(connection);
+    g_object_unref(connection);
+    std::cout << "[DBusAdapter] 点对点连接断开，当前连接数: " << adapter->peer_connections_.size() << std::endl;
+}
+
+// 只允许与服务端同一用户的进程直连
+gboolean DBusAdapter::on_authorize_peer(GDBusAuthObserver* /*observer*/, GIOStream* /*stream*/,
+                                        GCredentials* credentials, gpointer /*user_data*/) {
+    if (!credentials) {
+        return FALSE;
+    }
+    return g_credentials_get_unix_user(credentials, nullptr) == getuid();
+}
+
 void DBusAdapter::runLoop() {
     if (main_loop_) {
         g_main_loop_run(main_loop_);
@@ -178,77 +438,121 @@ void DBusAdapter::runLoop() {
 }
 
 
-using Handler = std::function<void(GVariant*, GDBusMethodInvocation*, ITestService*)>;
-static const std::unordered_map<std::string, Handler> method_table = {
-    {"SetTestBool", [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) {
+// 方法处理在主循环线程解码参数，返回的任务负责业务调用和应答：
+// Offload方法的任务投递到工作线程池，invocation在工作线程异步应答；
+// Inline方法（轻量调用）直接在主循环线程完成应答并返回nullptr，解码阶段已应答错误时同样返回nullptr
+enum class DispatchMode { Inline, Offload };
+using MethodTask = std::function<void()>;
+using Handler = MethodTask (*)(GVariant*, GDBusMethodInvocation*, ITestService*);
+struct MethodEntry {
+    const char* name;
+    DispatchMode mode;
+    Handler handler;
+};
+
+// 传输状态元组(sisiittbtt)，GetTransferStatus和GetTransferSnapshot共用
+static GVariant* build_status_tuple(const std::string& transferId, const TransferStatus& status) {
+    return g_variant_new("(sisiittbtt)",
+                         transferId.c_str(),
+                         status.statusCode,
+                         "传输状态",
+                         status.totalChunks,
+                         status.receivedChunks,
+                         (guint64)status.fileLength,
+                         (guint64)status.receivedLength,
+                         status.isCompleted,
+                         (guint64)status.startTime,
+                         (guint64)status.lastUpdateTime);
+}
+
+// 方法分派表，顺序与自省XML无关；编译期据此生成按方法名哈希的索引
+static constexpr MethodEntry method_table[] = {
+    {"GetPeerAddress", DispatchMode::Inline, [](GVariant*, GDBusMethodInvocation* inv, ITestService*) -> MethodTask {
+        // 连接管理方法由适配器自身应答，不经过业务接口；两种连接注册对象时user_data都是适配器
+        DBusAdapter* adapter = static_cast<DBusAdapter*>(g_dbus_method_invocation_get_user_data(inv));
+        g_dbus_method_invocation_return_value(inv, g_variant_new("(s)", adapter->getPeerAddress().c_str()));
+        return nullptr;
+    }},
+    {"Ping", DispatchMode::Inline, [](GVariant*, GDBusMethodInvocation* inv, ITestService*) -> MethodTask {
+        // 存活探测，不访问业务对象
+        g_dbus_method_invocation_return_value(inv, nullptr);
+        return nullptr;
+    }},
+    {"SetTestBool", DispatchMode::Inline, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         gboolean value;
         g_variant_get(params, "(b)", &value);
         bool result = svc->SetTestBool(value);
         g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        return nullptr;
     }},
-    {"SetTestInt", [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) {
+    {"SetTestInt", DispatchMode::Inline, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         gint32 value;
         g_variant_get(params, "(i)", &value);
         bool result = svc->SetTestInt(value);
         g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        return nullptr;
     }},
-    {"SetTestDouble", [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) {
+    {"SetTestDouble", DispatchMode::Inline, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         gdouble value;
         g_variant_get(params, "(d)", &value);
         bool result = svc->SetTestDouble(value);
         g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        return nullptr;
     }},
-    {"SetTestString", [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) {
+    {"SetTestString", DispatchMode::Inline, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         const gchar* value;
         g_variant_get(params, "(s)", &value);
         bool result = svc->SetTestString(value);
         g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        return nullptr;
     }},
-    {"SetTestInfo", [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) {
+    {"SetTestInfo", DispatchMode::Inline, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         gboolean b; gint32 i; gdouble d; const gchar* s;
         g_variant_get(params, "((bids))", &b, &i, &d, &s);
         TestInfo info{b, i, d, s};
         bool result = svc->SetTestInfo(info);
         g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        return nullptr;
     }},
-    {"GetTestBool", [](GVariant*, GDBusMethodInvocation* inv, ITestService* svc) {
+    {"GetTestBool", DispatchMode::Inline, [](GVariant*, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         bool result = svc->GetTestBool();
         g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        return nullptr;
     }},
-    {"GetTestInt", [](GVariant*, GDBusMethodInvocation* inv, ITestService* svc) {
+    {"GetTestInt", DispatchMode::Inline, [](GVariant*, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         int result = svc->GetTestInt();
         g_dbus_method_invocation_return_value(inv, g_variant_new("(i)", result));
+        return nullptr;
     }},
-    {"GetTestDouble", [](GVariant*, GDBusMethodInvocation* inv, ITestService* svc) {
+    {"GetTestDouble", DispatchMode::Inline, [](GVariant*, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         double result = svc->GetTestDouble();
         g_dbus_method_invocation_return_value(inv, g_variant_new("(d)", result));
+        return nullptr;
     }},
-    {"GetTestString", [](GVariant*, GDBusMethodInvocation* inv, ITestService* svc) {
+    {"GetTestString", DispatchMode::Inline, [](GVariant*, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         std::string result = svc->GetTestString();
         g_dbus_method_invocation_return_value(inv, g_variant_new("(s)", result.c_str()));
+        return nullptr;
     }},
-    {"GetTestInfo", [](GVariant*, GDBusMethodInvocation* inv, ITestService* svc) {
+    {"GetTestInfo", DispatchMode::Inline, [](GVariant*, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         TestInfo info = svc->GetTestInfo();
         g_dbus_method_invocation_return_value(inv, g_variant_new("((bids))", info.bool_param, info.int_param, info.double_param, info.string_param.c_str()));
+        return nullptr;
     }},
-    {"SendFileChunk", [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) {
-        FileChunk chunk;
-        
+    {"SendFileChunk", DispatchMode::Offload, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
         // 声明变量用于接收数据
         GVariant* byte_array_variant = nullptr;
-        gconstpointer data_ptr = nullptr;
-        gsize data_size = 0;
         gchar* userid = nullptr;
         gchar* fileName = nullptr;
         gint fileIndex = 0;
         guint totalChunks = 0;
         gint chunkLength = 0;
-        gint fileLength = 0;
+        guint64 fileLength = 0;
         guint fileMode = 0;
         gboolean isLastChunk = FALSE;
         gchar* transferId = nullptr;
         
-        g_variant_get(params, "(@ayssiuiiubs)", 
+        g_variant_get(params, "(@ayssiuitubs)", 
                     &byte_array_variant, 
                     &userid, 
                     &fileName, 
@@ -260,123 +564,383 @@ static const std::unordered_map<std::string, Handler> method_table = {
                     &isLastChunk,
                     &transferId);
         
-        // std::cout << "[DBusAdapter] transferId: " << (transferId ? transferId : "null") << std::endl;
-        // std::cout << "[ClientDBus] filemode:" << chunk.fileMode << std::endl;
-
-        if (byte_array_variant) {
-            data_ptr = g_variant_get_fixed_array(byte_array_variant, &data_size, sizeof(guchar));
-        }
-        
-        if (data_ptr && data_size > 0) {
-            size_t copy_size = (data_size > sizeof(chunk.data)) ? sizeof(chunk.data) : data_size;
-            memcpy(chunk.data, data_ptr, copy_size);
-        }
-        
-        if (userid) {
-            strncpy(chunk.userid, userid, sizeof(chunk.userid) - 1);
-            chunk.userid[sizeof(chunk.userid) - 1] = '\0';  
-        } else {
-            chunk.userid[0] = '\0';
-        }
-        
-        if (fileName) {
-            strncpy(chunk.fileName, fileName, sizeof(chunk.fileName) - 1);
-            chunk.fileName[sizeof(chunk.fileName) - 1] = '\0'; 
-        } else {
-            chunk.fileName[0] = '\0';
-        }
+        // 只拷贝元数据，负载以视图引用消息缓冲区
+        auto meta = std::make_shared<FileChunk>(userid ? userid : "", fileIndex, totalChunks,
+                                                fileName ? fileName : "", fileLength,
+                                                transferId ? transferId : "", fileMode, isLastChunk);
         
-        if (transferId) {
-            strncpy(chunk.transferId, transferId, sizeof(chunk.transferId) - 1);
-            chunk.transferId[sizeof(chunk.transferId) - 1] = '\0';
-        } else {
-            chunk.transferId[0] = '\0';
-        }
-        
-        // 设置其他字段
-        chunk.fileIndex = fileIndex;
-        chunk.totalChunks = totalChunks;
-        chunk.chunkLength = chunkLength;
-        chunk.fileLength = fileLength;
-        chunk.fileMode = fileMode;
-        chunk.isLastChunk = isLastChunk;
+        gsize data_size = 0;
+        ChunkView view;
+        view.meta = meta;
+        view.owner = hold_variant(params);
+        view.fileIndex = fileIndex;
+        view.data = static_cast<const char*>(g_variant_get_fixed_array(byte_array_variant, &data_size, sizeof(guchar)));
+        view.length = (data_size > FILE_CHUNK_SIZE) ? FILE_CHUNK_SIZE : data_size;
         
         // 清理GLib分配的资源
-        if (byte_array_variant) {
+        g_variant_unref(byte_array_variant);
+        g_free(userid);
+        g_free(fileName);
+        g_free(transferId);
+        
+        // 业务调用和应答在工作线程完成
+        return [inv, svc, view]() {
+            bool result = svc->SendFileChunks({view});
+            g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        };
+    }},
+    {"SendFileChunks", DispatchMode::Offload, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        GVariantIter* chunk_iter = nullptr;
+        gchar* userid = nullptr;
+        gchar* fileName = nullptr;
+        guint totalChunks = 0;
+        guint64 fileLength = 0;
+        guint fileMode = 0;
+        gchar* transferId = nullptr;
+
+        g_variant_get(params, "(a(iay)ssutus)",
+                    &chunk_iter,
+                    &userid,
+                    &fileName,
+                    &totalChunks,
+                    &fileLength,
+                    &fileMode,
+                    &transferId);
+
+        // 整批共享同一份传输元数据和消息引用，负载不做拷贝
+        auto meta = std::make_shared<FileChunk>(userid ? userid : "", 0, totalChunks,
+                                                fileName ? fileName : "", fileLength,
+                                                transferId ? transferId : "", fileMode);
+        std::shared_ptr<const void> owner = hold_variant(params);
+
+        std::vector<ChunkView> chunks;
+        chunks.reserve(g_variant_iter_n_children(chunk_iter));
+
+        gint fileIndex = 0;
+        GVariant* byte_array_variant = nullptr;
+        while (g_variant_iter_next(chunk_iter, "(i@ay)", &fileIndex, &byte_array_variant)) {
+            gsize data_size = 0;
+            ChunkView view;
+            view.meta = meta;
+            view.owner = owner;
+            view.fileIndex = fileIndex;
+            view.data = static_cast<const char*>(g_variant_get_fixed_array(byte_array_variant, &data_size, sizeof(guchar)));
+            view.length = (data_size > FILE_CHUNK_SIZE) ? FILE_CHUNK_SIZE : data_size;
+            chunks.push_back(std::move(view));
+
             g_variant_unref(byte_array_variant);
         }
+
+        // 清理GLib分配的资源
+        g_variant_iter_free(chunk_iter);
         g_free(userid);
         g_free(fileName);
         g_free(transferId);
-        
-        // 调用业务逻辑方法
-        bool result = svc->SendFileChunk(chunk);
-        
-        // 返回结果
+
+        return [inv, svc, chunks]() {
+            bool result = svc->SendFileChunks(chunks);
+            g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        };
+    }},
+    {"OpenTransfer", DispatchMode::Inline, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        const gchar* userid = nullptr;
+        const gchar* fileName = nullptr;
+        guint64 fileLength = 0;
+        guint fileMode = 0;
+        const gchar* transferId = nullptr;
+        guint chunkSize = 0;
+
+        g_variant_get(params, "(&s&stu&su)", &userid, &fileName, &fileLength, &fileMode, &transferId, &chunkSize);
+
+        // 总块数由服务端按协商后的块大小计算
+        FileChunk meta(userid ? userid : "", 0, 0, fileName ? fileName : "", fileLength,
+                       transferId ? transferId : "", fileMode);
+        TransferSession session = svc->OpenTransfer(meta, chunkSize);
+        if (session.handle != 0) {
+            // 确认只推送给打开传输的这个客户端
+            DBusAdapter* adapter = static_cast<DBusAdapter*>(g_dbus_method_invocation_get_user_data(inv));
+            adapter->setChunkAckRoute(meta.transferId, session.handle, g_dbus_method_invocation_get_connection(inv),
+                                      g_dbus_method_invocation_get_sender(inv));
+        }
+        g_dbus_method_invocation_return_value(inv, g_variant_new("(uuuu)", session.handle, session.chunkSize,
+                                                                 (guint)session.totalChunks, session.credit));
+        return nullptr;
+    }},
+    {"SendSessionChunks", DispatchMode::Offload, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        guint32 handle = 0;
+        GVariantIter* chunk_iter = nullptr;
+        g_variant_get(params, "(ua(iay))", &handle, &chunk_iter);
+
+        // 元数据由会话提供，视图只引用消息中的负载
+        std::shared_ptr<const void> owner = hold_variant(params);
+        std::vector<ChunkView> chunks;
+        chunks.reserve(g_variant_iter_n_children(chunk_iter));
+
+        gint fileIndex = 0;
+        GVariant* byte_array_variant = nullptr;
+        while (g_variant_iter_next(chunk_iter, "(i@ay)", &fileIndex, &byte_array_variant)) {
+            gsize data_size = 0;
+            ChunkView view;
+            view.owner = owner;
+            view.fileIndex = fileIndex;
+            view.data = static_cast<const char*>(g_variant_get_fixed_array(byte_array_variant, &data_size, sizeof(guchar)));
+            view.length = data_size; // 块大小按会话协商，由接收器校验
+            chunks.push_back(std::move(view));
+
+            g_variant_unref(byte_array_variant);
+        }
+        g_variant_iter_free(chunk_iter);
+
+        return [inv, svc, handle, chunks]() {
+            // 应答携带服务端授予的在途额度，发送端据此调整窗口；
+            // 流式发送的调用带NO_REPLY_EXPECTED标志，GDBus不会发出应答，确认改由ChunksAcked信号推送
+            guint32 credit = 0;
+            bool result = svc->SendSessionChunks(handle, chunks, credit);
+            g_dbus_method_invocation_return_value(inv, g_variant_new("(bu)", result, credit));
+        };
+    }},
+    {"CloseTransfer", DispatchMode::Inline, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        guint32 handle = 0;
+        g_variant_get(params, "(u)", &handle);
+
+        bool result = svc->CloseTransfer(handle);
+        static_cast<DBusAdapter*>(g_dbus_method_invocation_get_user_data(inv))->dropChunkAckRoute(handle);
         g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        return nullptr;
     }},
-    {"GetTransferStatus", [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) {
-        gchar* transferId = nullptr;
+    {"SendFileRange", DispatchMode::Offload, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        gint32 fd_handle = -1;
+        guint64 offset = 0;
+        guint64 length = 0;
+        gint firstIndex = 0;
         gchar* userid = nullptr;
         gchar* fileName = nullptr;
-        
-        g_variant_get(params, "(sss)", &transferId, &userid, &fileName);
-        
-        // 调用业务逻辑获取传输状态
-        TransferStatus status = svc->GetTransferStatus(
-            transferId ? transferId : "", 
-            userid ? userid : "", 
-            fileName ? fileName : "");
-        
-        // 返回传输状态，格式为(sisiiuibtt)
-        g_dbus_method_invocation_return_value(inv, 
-            g_variant_new("((sisiiuibtt))", 
-                transferId ? transferId : "", 
-                status.statusCode, 
-                "传输状态", 
-                status.totalChunks, 
-                status.receivedChunks, 
-                (guint)status.fileLength, 
-                status.receivedLength, 
-                status.isCompleted,
-                (guint64)time(nullptr) - 3600, // 开始时间（示例：1小时前）
-                (guint64)time(nullptr)));      // 最后更新时间
-        
-        g_free(transferId);
+        guint totalChunks = 0;
+        guint64 fileLength = 0;
+        guint fileMode = 0;
+        gchar* transferId = nullptr;
+
+        g_variant_get(params, "(httissutus)",
+                    &fd_handle,
+                    &offset,
+                    &length,
+                    &firstIndex,
+                    &userid,
+                    &fileName,
+                    &totalChunks,
+                    &fileLength,
+                    &fileMode,
+                    &transferId);
+
+        FileChunk meta(userid ? userid : "", firstIndex, totalChunks,
+                       fileName ? fileName : "", fileLength,
+                       transferId ? transferId : "", fileMode);
+
         g_free(userid);
         g_free(fileName);
+        g_free(transferId);
+
+        // 从消息附带的FD列表中取出描述符（返回的是dup后的副本，由接收器负责关闭）
+        GUnixFDList* fd_list = g_dbus_message_get_unix_fd_list(g_dbus_method_invocation_get_message(inv));
+        GError* error = nullptr;
+        gint fd = fd_list ? g_unix_fd_list_get(fd_list, fd_handle, &error) : -1;
+        if (fd < 0) {
+            std::cerr << "[DBusAdapter] SendFileRange获取文件描述符失败: " << (error ? error->message : "no fd list") << std::endl;
+            if (error) g_error_free(error);
+            g_dbus_method_invocation_return_error(inv, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Invalid file descriptor");
+            return nullptr;
+        }
+
+        return [inv, svc, meta, fd, offset, length]() {
+            bool result = svc->SendFileRange(meta, fd, offset, length);
+            g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        };
     }},
-    {"GetMissingChunks", [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) {
-        gchar* transferId = nullptr;
+    {"OpenShmTransfer", DispatchMode::Inline, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        gint32 handles[3] = {-1, -1, -1};
         gchar* userid = nullptr;
         gchar* fileName = nullptr;
+        guint totalChunks = 0;
+        guint64 fileLength = 0;
+        guint fileMode = 0;
+        gchar* transferId = nullptr;
+
+        g_variant_get(params, "(hhhssutus)",
+                    &handles[0],
+                    &handles[1],
+                    &handles[2],
+                    &userid,
+                    &fileName,
+                    &totalChunks,
+                    &fileLength,
+                    &fileMode,
+                    &transferId);
+
+        FileChunk meta(userid ? userid : "", 0, totalChunks,
+                       fileName ? fileName : "", fileLength,
+                       transferId ? transferId : "", fileMode);
+
+        g_free(userid);
+        g_free(fileName);
+        g_free(transferId);
+
+        // 依次取出memfd、数据就绪eventfd、空间就绪eventfd
+        GUnixFDList* fd_list = g_dbus_message_get_unix_fd_list(g_dbus_method_invocation_get_message(inv));
+        gint fds[3] = {-1, -1, -1};
+        bool fds_ok = (fd_list != nullptr);
+        for (int i = 0; i < 3 && fds_ok; ++i) {
+            fds[i] = g_unix_fd_list_get(fd_list, handles[i], nullptr);
+            fds_ok = (fds[i] >= 0);
+        }
+        if (!fds_ok) {
+            for (gint fd : fds) {
+                if (fd >= 0) close(fd);
+            }
+            std::cerr << "[DBusAdapter] OpenShmTransfer获取文件描述符失败" << std::endl;
+            g_dbus_method_invocation_return_error(inv, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Invalid file descriptors");
+            return nullptr;
+        }
+
+        bool result = svc->OpenShmTransfer(meta, fds[0], fds[1], fds[2]);
+        g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        return nullptr;
+    }},
+    {"CommitShmTransfer", DispatchMode::Inline, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        const gchar* transferId = nullptr;
+        g_variant_get(params, "(&s)", &transferId);
+
+        bool result = svc->CommitShmTransfer(transferId ? transferId : "");
+        g_dbus_method_invocation_return_value(inv, g_variant_new("(b)", result));
+        return nullptr;
+    }},
+    {"GetTransferStatus", DispatchMode::Offload, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        const gchar* transferId = nullptr;
+        const gchar* userid = nullptr;
+        const gchar* fileName = nullptr;
         
-        g_variant_get(params, "(sss)", &transferId, &userid, &fileName);
+        g_variant_get(params, "(&s&s&s)", &transferId, &userid, &fileName);
         
-        // 调用业务逻辑获取缺失块列表
-        std::vector<int> missingChunks = svc->GetMissingChunks(
-            transferId ? transferId : "", 
-            userid ? userid : "", 
-            fileName ? fileName : "");
+        return [inv, svc, id = std::string(transferId), user = std::string(userid), name = std::string(fileName)]() {
+            // 调用业务逻辑获取传输状态
+            TransferStatus status = svc->GetTransferStatus(id, user, name);
+            
+            // 返回传输状态，格式为(sisiittbtt)
+            g_dbus_method_invocation_return_value(inv, g_variant_new("(@(sisiittbtt))", build_status_tuple(id, status)));
+        };
+    }},
+    {"GetTransferSnapshot", DispatchMode::Offload, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        const gchar* transferId = nullptr;
+        const gchar* userid = nullptr;
+        const gchar* fileName = nullptr;
         
-        // 将vector<int>转换为GVariant数组
-        GVariantBuilder* builder = g_variant_builder_new(G_VARIANT_TYPE("ai"));
-        for (int chunkIndex : missingChunks) {
-            g_variant_builder_add(builder, "i", chunkIndex);
-        }
+        g_variant_get(params, "(&s&s&s)", &transferId, &userid, &fileName);
         
-        // 返回缺失块列表
-        g_dbus_method_invocation_return_value(inv, 
-            g_variant_new("(ai)", builder));
+        return [inv, svc, id = std::string(transferId), user = std::string(userid), name = std::string(fileName)]() {
+            TransferStatus status = svc->GetTransferStatus(id, user, name);
+            
+            // 状态和已接收位图一次返回，位图取紧凑位图和游程编码中较小的一种
+            guint8 encoding = BITMAP_ENCODING_PACKED;
+            std::vector<uint8_t> bitmap = status.encodeBitmap(encoding);
+            GVariant* bitmap_variant = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, bitmap.data(),
+                                                                 bitmap.size(), sizeof(guint8));
+            g_dbus_method_invocation_return_value(inv, g_variant_new("(@(sisiittbtt)y@ay)",
+                                                                     build_status_tuple(id, status), encoding,
+                                                                     bitmap_variant));
+        };
+    }},
+    {"GetMissingChunks", DispatchMode::Offload, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        const gchar* transferId = nullptr;
+        const gchar* userid = nullptr;
+        const gchar* fileName = nullptr;
         
-        g_variant_builder_unref(builder);
-        g_free(transferId);
-        g_free(userid);
-        g_free(fileName);
+        g_variant_get(params, "(&s&s&s)", &transferId, &userid, &fileName);
+        
+        return [inv, svc, id = std::string(transferId), user = std::string(userid), name = std::string(fileName)]() {
+            // 调用业务逻辑获取缺失块列表
+            std::vector<int> missingChunks = svc->GetMissingChunks(id, user, name);
+            
+            // 缺失块索引整体拷贝为定长数组
+            GVariant* chunks = g_variant_new_fixed_array(G_VARIANT_TYPE_INT32, missingChunks.data(),
+                                                         missingChunks.size(), sizeof(gint32));
+            
+            // 返回缺失块列表
+            g_dbus_method_invocation_return_value(inv, g_variant_new("(@ai)", chunks));
+        };
+    }},
+    {"GetMissingRanges", DispatchMode::Offload, [](GVariant* params, GDBusMethodInvocation* inv, ITestService* svc) -> MethodTask {
+        guint32 handle = 0;
+        guint32 cursor = 0;
+        guint32 limit = 0;
+        g_variant_get(params, "(uuu)", &handle, &cursor, &limit);
+        
+        return [inv, svc, handle, cursor, limit]() {
+            std::vector<ChunkRange> ranges;
+            uint32_t next = 0;
+            if (!svc->GetMissingRanges(handle, cursor, limit, ranges, next)) {
+                g_dbus_method_invocation_return_error(inv, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Invalid transfer handle");
+                return;
+            }
+            
+            // 每个范围编码为(first, count)，消息大小与缺口数成正比
+            GVariantBuilder* builder = g_variant_builder_new(G_VARIANT_TYPE("a(uu)"));
+            for (const ChunkRange& range : ranges) {
+                g_variant_builder_add(builder, "(uu)", (guint32)range.first, (guint32)range.count);
+            }
+            g_dbus_method_invocation_return_value(inv, g_variant_new("(a(uu)u)", builder, next));
+            g_variant_builder_unref(builder);
+        };
     }}
 };
 
-void DBusAdapter::handle_method_call(GDBusConnection* /*connection*/,
+// 方法名的FNV-1a哈希，编译期和运行期共用
+static constexpr uint32_t method_hash(const char* name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ static_cast<unsigned char>(*name++)) * 16777619u;
+    }
+    return hash;
+}
+
+static constexpr size_t METHOD_COUNT = sizeof(method_table) / sizeof(method_table[0]);
+static constexpr size_t METHOD_SLOT_COUNT = 64; // 2的幂，保持装载率低于1/2
+static_assert(METHOD_COUNT * 2 <= METHOD_SLOT_COUNT, "method slot table too small");
+
+// 编译期构建的开放寻址索引：槽位保存method_table下标，空槽为-1
+struct MethodIndex {
+    int8_t slots[METHOD_SLOT_COUNT];
+};
+
+static constexpr MethodIndex build_method_index() {
+    MethodIndex index{};
+    for (size_t i = 0; i < METHOD_SLOT_COUNT; ++i) {
+        index.slots[i] = -1;
+    }
+    for (size_t i = 0; i < METHOD_COUNT; ++i) {
+        size_t slot = method_hash(method_table[i].name) & (METHOD_SLOT_COUNT - 1);
+        while (index.slots[slot] >= 0) {
+            slot = (slot + 1) & (METHOD_SLOT_COUNT - 1);
+        }
+        index.slots[slot] = static_cast<int8_t>(i);
+    }
+    return index;
+}
+
+static constexpr MethodIndex method_index = build_method_index();
+
+// 按方法名查找分派项：一次哈希加线性探测，不分配内存
+static const MethodEntry* find_method(const char* name) {
+    size_t slot = method_hash(name) & (METHOD_SLOT_COUNT - 1);
+    while (method_index.slots[slot] >= 0) {
+        const MethodEntry& entry = method_table[method_index.slots[slot]];
+        if (strcmp(entry.name, name) == 0) {
+            return &entry;
+        }
+        slot = (slot + 1) & (METHOD_SLOT_COUNT - 1);
+    }
+    return nullptr;
+}
+
+void DBusAdapter::handle_method_call(GDBusConnection* connection,
                                      const gchar* sender,
                                      const gchar* /*object_path*/,
                                      const gchar* /*interface_name*/,
@@ -385,18 +949,45 @@ void DBusAdapter::handle_method_call(GDBusConnection* /*connection*/,
                                      GDBusMethodInvocation* invocation,
                                      gpointer user_data) {
     DBusAdapter* adapter = static_cast<DBusAdapter*>(user_data);
-    ITestService* service = adapter->getTestService();
 
-    // 记录客户端标识信息
-    if (sender) {
-        std::cout << "[DBusAdapter] 收到来自客户端 " << sender << " 的方法调用: " << method_name << std::endl;
-    } else {
-        std::cout << "[DBusAdapter] 收到方法调用: " << method_name << " (发送者未知)" << std::endl;
+    // 总线连接只有一条：按发送者散列到分派线程，同一客户端的调用保持顺序。
+    // 点对点连接注册时已绑定到分派线程，直接在当前线程处理
+    if (connection == adapter->connection_ && sender && !adapter->dispatch_threads_.empty()) {
+        size_t index = g_str_hash(sender) % adapter->dispatch_threads_.size();
+        g_main_context_invoke(adapter->dispatch_threads_[index]->context, run_routed_method_call, invocation);
+        return;
     }
 
-    auto it = method_table.find(method_name);
-    if (it != method_table.end()) {
-        it->second(parameters, invocation, service);
+    dispatch_method_call(adapter, method_name, parameters, invocation);
+}
+
+// 在分派线程上处理转发过来的总线调用，invocation的所有权随之转移
+gboolean DBusAdapter::run_routed_method_call(gpointer user_data) {
+    GDBusMethodInvocation* invocation = static_cast<GDBusMethodInvocation*>(user_data);
+    DBusAdapter* adapter = static_cast<DBusAdapter*>(g_dbus_method_invocation_get_user_data(invocation));
+    dispatch_method_call(adapter,
+                         g_dbus_method_invocation_get_method_name(invocation),
+                         g_dbus_method_invocation_get_parameters(invocation),
+                         invocation);
+    return G_SOURCE_REMOVE;
+}
+
+// 查表解码并执行方法：Inline方法在当前线程应答，Offload方法投递到工作线程池
+void DBusAdapter::dispatch_method_call(DBusAdapter* adapter, const gchar* method_name,
+                                       GVariant* parameters, GDBusMethodInvocation* invocation) {
+    ITestService* service = adapter->getTestService();
+
+    const MethodEntry* entry = find_method(method_name);
+    if (entry) {
+        MethodTask task = entry->handler(parameters, invocation, service);
+        if (!task) {
+            return;
+        }
+        if (entry->mode == DispatchMode::Offload && adapter->worker_pool_) {
+            adapter->worker_pool_->enqueue(std::move(task));
+        } else {
+            task();
+        }
     } else {
         std::cerr << "[DBusAdapter] Unknown method: " << method_name << std::endl;
         g_dbus_method_invocation_return_error(invocation, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Unknown method");
@@ -461,3 +1052,89 @@ void DBusAdapter::emitTestInfoChanged(const TestInfo& info) {
             g_variant_new("((bids))", info.bool_param, info.int_param, info.double_param, info.string_param.c_str()), nullptr);
     }
 }
+
+// 确认是单播信号：总线上发给打开传输的发送者唯一名，点对点连接上直接发给对端；
+// 没有投递目标（未经OpenTransfer或会话已关闭）的传输不推送
+void DBusAdapter::emitChunksAcked(const ChunkAck& ack) {
+    GDBusConnection* connection = nullptr;
+    std::string sender;
+    {
+        std::lock_guard<std::mutex> lock(ack_routes_mutex_);
+        auto it = ack_routes_.find(ack.transferId);
+        if (it == ack_routes_.end()) {
+            return;
+        }
+        connection = G_DBUS_CONNECTION(g_object_ref(it->second.connection));
+        sender = it->second.sender;
+    }
+
+    if (!g_dbus_connection_is_closed(connection)) {
+        GVariantBuilder* ranges_builder = g_variant_builder_new(G_VARIANT_TYPE("a(ii)"));
+        for (const ChunkRange& range : ack.ranges) {
+            g_variant_builder_add(ranges_builder, "(ii)", range.first, range.count);
+        }
+        g_dbus_connection_emit_signal(
+            connection, sender.empty() ? nullptr : sender.c_str(),
+            "/com/example/TestService",
+            "com.example.ITestService",
+            "ChunksAcked",
+            g_variant_new("(sba(ii)u)", ack.transferId.c_str(), ack.snapshot, ranges_builder, ack.credit), nullptr);
+        g_variant_builder_unref(ranges_builder);
+    }
+    g_object_unref(connection);
+}
+
+void DBusAdapter::setChunkAckRoute(const std::string& transferId, uint32_t handle, GDBusConnection* connection,
+                                   const char* sender) {
+    ChunkAckRoute route;
+    route.connection = G_DBUS_CONNECTION(g_object_ref(connection));
+    route.sender = sender ? sender : "";
+    route.handle = handle;
+
+    GDBusConnection* replaced = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(ack_routes_mutex_);
+        ChunkAckRoute& slot = ack_routes_[transferId];
+        replaced = slot.connection;
+        slot = route;
+    }
+    if (replaced) {
+        g_object_unref(replaced);
+    }
+}
+
+void DBusAdapter::dropChunkAckRoute(uint32_t handle) {
+    GDBusConnection* dropped = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(ack_routes_mutex_);
+        for (auto it = ack_routes_.begin(); it != ack_routes_.end(); ++it) {
+            if (it->second.handle == handle) {
+                dropped = it->second.connection;
+                ack_routes_.erase(it);
+                break;
+            }
+        }
+    }
+    if (dropped) {
+        g_object_unref(dropped);
+    }
+}
+
+// 丢弃经某个连接打开的传输的投递目标（连接断开时），connection为nullptr时全部丢弃
+void DBusAdapter::dropChunkAckRoutes(GDBusConnection* connection) {
+    std::vector<GDBusConnection*> dropped;
+    {
+        std::lock_guard<std::mutex> lock(ack_routes_mutex_);
+        for (auto it = ack_routes_.begin(); it != ack_routes_.end();) {
+            if (connection == nullptr || it->second.connection == connection) {
+                dropped.push_back(it->second.connection);
+                it = ack_routes_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (GDBusConnection* conn : dropped) {
+        g_object_unref(conn);
+    }
+}
@@ -13,6 +13,10 @@ TestService::TestService(DBusAdapter* dbus_adapter) : dbus_adapter_(dbus_adapter
 
 void TestService::setDBusAdapter(DBusAdapter* dbus_adapter) {
     dbus_adapter_ = dbus_adapter;
+    // 接收器的选择性确认经D-Bus信号推送给发送端
+    ::set_chunk_ack_callback([this](const ChunkAck& ack) {
+        broadcastChunksAcked(ack);
+    });
 }
 
 // ITestService接口实现 - Set方法
@@ -164,10 +168,58 @@ bool TestService::SendFileChunk(const FileChunk& chunk) {
     // 设置输出目录为当前目录
     std::string outdir = ".";
     
-    // 将文件块传递给FileReceiver处理
-    ::receive_file_chunk(chunk, outdir);
-    // std::cout << "[TestService] 文件块已传递给FileReceiver处理" << std::endl;
-    return true;
+    // 将文件块传递给FileReceiver处理，内存预算已满时返回失败由客户端重试
+    return ::receive_file_chunk(chunk, outdir) == 0;
+}
+
+// 批量接收文件块视图，整批交给FileReceiver处理
+bool TestService::SendFileChunks(const std::vector<ChunkView>& chunks) {
+    std::string outdir = ".";
+
+    return ::receive_chunk_views(chunks, outdir) == 0;
+}
+
+// 打开传输会话，返回会话句柄和协商后的块大小
+TransferSession TestService::OpenTransfer(const FileChunk& meta, uint32_t chunkSize) {
+    std::string outdir = ".";
+
+    std::cout << "[TestService] OpenTransfer: transferId=" << meta.transferId 
+              << ", fileName=" << meta.fileName 
+              << ", chunkSize=" << chunkSize << std::endl;
+    return ::open_transfer(meta, chunkSize, outdir);
+}
+
+// 按会话句柄批量接收文件块视图，同时返回授予的在途额度
+bool TestService::SendSessionChunks(uint32_t handle, const std::vector<ChunkView>& chunks, uint32_t& credit) {
+    return ::receive_session_chunks(handle, chunks, &credit) == 0;
+}
+
+// 关闭传输会话
+bool TestService::CloseTransfer(uint32_t handle) {
+    std::cout << "[TestService] CloseTransfer: handle=" << handle << std::endl;
+    return ::close_transfer(handle) == 0;
+}
+
+// 接收FD传递的文件范围，由FileReceiver直接拷贝到目标文件
+bool TestService::SendFileRange(const FileChunk& meta, int fd, uint64_t offset, uint64_t length) {
+    std::string outdir = ".";
+
+    return ::receive_file_range(meta, fd, static_cast<off_t>(offset), static_cast<size_t>(length), outdir) == 0;
+}
+
+// 建立共享内存传输通道
+bool TestService::OpenShmTransfer(const FileChunk& meta, int mem_fd, int data_efd, int space_efd) {
+    std::string outdir = ".";
+
+    std::cout << "[TestService] OpenShmTransfer: transferId=" << meta.transferId 
+              << ", fileName=" << meta.fileName << std::endl;
+    return ::open_shm_transfer(meta, mem_fd, data_efd, space_efd, outdir) == 0;
+}
+
+// 结束共享内存传输通道
+bool TestService::CommitShmTransfer(const std::string& transferId) {
+    std::cout << "[TestService] CommitShmTransfer: transferId=" << transferId << std::endl;
+    return ::commit_shm_transfer(transferId) == 0;
 }
 
 // 获取需要重传块的信息
@@ -186,6 +238,21 @@ std::vector<int> TestService::GetMissingChunks(const std::string& transferId, co
     return ::get_missing_chunks(transferId, userid, fileName);
 }
 
+// 按会话分页获取缺失块范围，单页范围数限制在MAX_MISSING_RANGES_PER_PAGE以内
+bool TestService::GetMissingRanges(uint32_t handle, uint32_t cursor, uint32_t limit,
+                                   std::vector<ChunkRange>& ranges, uint32_t& next) {
+    if (limit == 0 || limit > MAX_MISSING_RANGES_PER_PAGE) {
+        limit = MAX_MISSING_RANGES_PER_PAGE;
+    }
+    
+    int next_index = 0;
+    if (::get_missing_ranges(handle, static_cast<int>(cursor), limit, ranges, next_index) != 0) {
+        return false;
+    }
+    next = static_cast<uint32_t>(next_index);
+    return true;
+}
+
 // 观察者模式相关方法
 void TestService::registerListener(ITestListener* listener) {
     if (listener) {
@@ -260,4 +327,11 @@ void TestService::broadcastTestInfoChanged(const TestInfo& param) {
     if (dbus_adapter_) {
         dbus_adapter_->emitTestInfoChanged(param);
     }
-}
\ No newline at end of file
+}
+
+// 选择性确认只经D-Bus推送，不通知本地观察者
+void TestService::broadcastChunksAcked(const ChunkAck& ack) {
+    if (dbus_adapter_) {
+        dbus_adapter_->emitChunksAcked(ack);
+    }
+}
@@ -1,8 +1,11 @@
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <dirent.h>
 #include <unistd.h>
 #include <vector>
 #include <map>
+#include <functional>
 #include <thread>
 #include <fstream>
 #include <cstring>
@@ -13,9 +16,14 @@
 #include "FileReceiver.h"
 #include "ThreadPool.h"
 #include "MemoryPool.h"
+#include "ShmRing.h"
 #include <libgen.h>  
 #include <cstdlib>
 #include <chrono>
+#include <algorithm>
+#include <condition_variable>
+#include <cerrno>
+#include <limits>
 
 // 线程池实例
 static ThreadPool* receiver_thread_pool = nullptr;
@@ -23,31 +31,880 @@ static ThreadPool* receiver_thread_pool = nullptr;
 // 内存池实例 - 用于控制服务器端内存使用
 static std::unique_ptr<MemoryPool> server_memory_pool = nullptr;
 
-// 内存使用限制
+// 内存使用限制：批次进入线程池队列时登记，处理完成后释放
 static const size_t MAX_SERVER_MEMORY_BYTES = 100 * 1024 * 1024; // 100MB限制
 static std::atomic<size_t> current_memory_usage{0};
-static std::mutex memory_mutex_;
-static std::condition_variable memory_cv_;
 
-// 文件传输状态映射 - 使用传输ID作为键
-static std::map<std::string, TransferStatus> file_transfer_states;
-static std::mutex transfer_states_mutex;
+// 信用流控：按剩余内存预算和队列深度给每个会话授予在途额度
+static const size_t MAX_TRANSFER_CREDIT_BYTES = 32 * 1024 * 1024;   // 单个传输的额度上限
+static const size_t MAX_QUEUED_TASKS_PER_THREAD = 16;               // 每个线程允许积压的任务数
+static std::atomic<size_t> active_transfers{0};                     // 队列中有积压批次的传输数
 
-// 传输状态持久化存储文件路径
-static const std::string TRANSFER_STATUS_FILE = "./transfer_status.dat";
+// 内存中的文件块缓存（缓存模式）：按块号直接寻址的大块缓冲区（slab），块数据存放在它在文件中的偏移处。
+// 插入是一次定位和拷贝，不需要逐块的节点、分配或时间戳，收到的D-Bus消息也可以立即释放；
+// 哪些块已经存入由传输位图记录，这里不另存元数据
+struct ChunkStore {
+    static const size_t SLAB_BYTES = 4 * 1024 * 1024;
+    size_t slabBytes = 0;                         // 每个slab的字节数，为块大小的整数倍，块不会跨slab
+    std::vector<std::unique_ptr<char[]>> slabs;   // 按需分配，覆盖整个文件
+    size_t storedBytes = 0;                       // 已存入的负载字节数
 
-// GDBus缓冲区实现 - 内存中的文件块缓存
-struct FileChunkCache {
-    std::vector<uint8_t> data;
-    size_t chunkIndex;
-    std::chrono::steady_clock::time_point timestamp;
+    bool empty() const { return storedBytes == 0; }
+
+    // 存入一个块（同一块只存一次），块必须完整落在[0, fileLength)内，否则拒绝并返回false
+    bool put(int index, uint32_t chunkSize, uint64_t fileLength, const char* data, size_t length) {
+        uint64_t offset = static_cast<uint64_t>(index) * chunkSize;
+        if (index < 0 || chunkSize == 0 || length > chunkSize || offset + length > fileLength) {
+            return false;
+        }
+        if (slabBytes == 0) {
+            slabBytes = std::max<size_t>(1, SLAB_BYTES / chunkSize) * chunkSize;
+            slabs.resize((fileLength + slabBytes - 1) / slabBytes);
+        }
+        size_t slab_index = offset / slabBytes;
+        if (slab_index >= slabs.size()) {
+            return false;
+        }
+        std::unique_ptr<char[]>& slab = slabs[slab_index];
+        if (!slab) {
+            slab.reset(new char[slabBytes]);
+        }
+        memcpy(slab.get() + offset % slabBytes, data, length);
+        storedBytes += length;
+        return true;
+    }
+
+    // 按文件偏移取出[offset, offset + length)所在slab中的连续数据，返回本段长度（不跨slab），数据不存在时返回0
+    size_t read(uint64_t offset, uint64_t length, const char** data) const {
+        size_t slab = slabBytes ? offset / slabBytes : slabs.size();
+        if (slab >= slabs.size() || !slabs[slab]) {
+            return 0;
+        }
+        size_t in_slab = offset % slabBytes;
+        *data = slabs[slab].get() + in_slab;
+        return static_cast<size_t>(std::min<uint64_t>(length, slabBytes - in_slab));
+    }
+
+    void clear() {
+        slabs.clear();
+        slabBytes = 0;
+        storedBytes = 0;
+    }
+};
+
+// 打开的目标文件描述符，最后一个持有者释放时关闭
+struct OutputFile {
+    int fd = -1;
+    explicit OutputFile(int fd_) : fd(fd_) {}
+    ~OutputFile() { if (fd >= 0) close(fd); }
+};
+
+// 直写目标文件 - 第一次写入时创建临时文件并预分配空间，之后所有块按偏移直接写入，完成时重命名。
+// 描述符随传输保存到收尾，写入线程和日志线程都只用这一个描述符，不按路径重新打开
+struct TransferOutput {
+    bool created = false;
+    std::string tempPath;
+    std::string finalPath;
+    std::shared_ptr<OutputFile> file;            // 临时文件的描述符，从日志恢复的传输在第一次写入时打开
+};
+
+// 直写模式开关：开启时会话和批量块不在内存中缓存，服务端内存占用只剩位图
+static std::atomic<bool> direct_write_enabled{true};
+
+struct TransferJournal;
+
+// 单个传输的全部接收状态：元数据、位图、缓存块和直写目标文件，由自身的互斥锁保护；
+// 块的认领位和剩余块数是原子的，直写时在锁外决定哪个线程负责一个块以及哪个线程触发完成
+struct TransferState {
+    std::mutex mutex;
+    std::shared_ptr<const FileChunk> meta;       // 传输元数据（data字段不使用）
+    std::string outdir;
+    uint32_t chunkSize = FILE_CHUNK_SIZE;        // 块大小，块索引乘以它得到文件偏移
+    TransferStatus status;
+    ChunkStore chunks;                           // 尚未直写时缓存的块
+    TransferOutput output;
+    uint32_t handle = 0;                         // 会话句柄，0表示未打开会话（受sessions_mutex保护）
+    bool finished = false;
+    std::atomic<size_t> queuedBytes{0};          // 已进入线程池队列尚未处理的字节数
+    std::vector<ChunkRange> pendingAck;          // 上次确认以来新收到的块范围
+    bool ackSnapshot = false;                    // 下次确认推送完整的已接收集合
+    bool ackQueued = false;                      // 已登记到待确认列表
+    std::unique_ptr<std::atomic<uint64_t>[]> claimed; // 已写入的块（每块1位），写入完成后才置位
+    std::atomic<int> remaining{0};               // 尚未认领的块数，减到0的线程负责完成传输
+    std::shared_ptr<TransferJournal> journal;    // 直写传输的持久化日志
+    bool journalQueued = false;                  // 已登记到待刷新日志列表
+};
+
+// 文件传输状态表 - 按传输ID哈希分片，每个分片一把锁，不同传输的建立和查询互不争用
+static const size_t TRANSFER_STATE_SHARDS = 16;
+struct TransferShard {
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<TransferState>> states;
+};
+static TransferShard transfer_shards[TRANSFER_STATE_SHARDS];
+
+static TransferShard& transfer_shard(const std::string& transferId) {
+    return transfer_shards[std::hash<std::string>()(transferId) % TRANSFER_STATE_SHARDS];
+}
+
+// 传输会话表 - 句柄低16位为槽位下标，高16位为槽位代数，槽位复用后旧句柄不会误命中
+static const size_t MAX_TRANSFER_SESSIONS = 0x10000;
+struct SessionSlot {
+    std::shared_ptr<TransferState> state;
+    uint16_t generation = 0;
+};
+static std::vector<SessionSlot> session_slots;
+static std::vector<uint32_t> free_session_slots;
+static std::mutex sessions_mutex;
+
+// 选择性确认：有新接收块的传输登记到待确认列表，由确认线程定期合并推送
+static std::vector<std::shared_ptr<TransferState>> ack_pending_states;
+static std::mutex ack_mutex;
+static std::condition_variable ack_cv;
+static std::thread ack_thread;
+static bool ack_thread_stop = false;
+static ChunkAckCallback chunk_ack_callback;
+
+// 传输日志：每个直写传输一个日志文件，文件头记录元数据，后面是映射到内存的已接收位图。
+// 位图只在目标文件数据落盘后才更新，服务端重启后据此重建传输状态，客户端只需补发缺失的块
+static const std::string TRANSFER_JOURNAL_DIR = "./transfer_journal";
+static const uint32_t JOURNAL_MAGIC = 0x314A5446;                  // "FTJ1"
+static const uint32_t JOURNAL_VERSION = 1;
+static const int JOURNAL_FLUSH_INTERVAL_MS = 1000;                  // 成组刷新间隔
+static const int JOURNAL_NAME_PROBES = 8;                           // 文件名哈希冲突时尝试的备用名数
+static const time_t JOURNAL_EXPIRE_SECONDS = 7 * 24 * 3600;         // 超过该时长未更新的日志视为已放弃
+
+struct JournalHeader {
+    uint32_t magic;
+    uint32_t version;
+    char transferId[MAX_TRANSFER_ID_LENGTH];
+    char userid[20];
+    char fileName[MAX_FILE_NAME_LENGTH];
+    char outdir[MAX_FILE_NAME_LENGTH];
+    int64_t fileLength;
+    uint32_t fileMode;
+    uint32_t chunkSize;
+    int32_t totalChunks;
+    uint32_t reserved;
+};
+static_assert(sizeof(JournalHeader) % sizeof(uint64_t) == 0, "位图需按8字节对齐");
+
+// 映射到内存的日志文件，最后一个持有者释放时解除映射
+struct TransferJournal {
+    std::string path;
+    void* map = MAP_FAILED;
+    size_t mapSize = 0;
+    bool dirSynced = false;                      // 日志和临时文件的目录项已落盘（只由日志线程访问）
+    
+    JournalHeader* header() { return static_cast<JournalHeader*>(map); }
+    uint64_t* words() { return reinterpret_cast<uint64_t*>(static_cast<char*>(map) + sizeof(JournalHeader)); }
+    ~TransferJournal() { if (map != MAP_FAILED) munmap(map, mapSize); }
+};
+
+// 待刷新日志的传输，由日志线程定期成组提交
+static std::vector<std::shared_ptr<TransferState>> journal_pending_states;
+static std::mutex journal_mutex;
+static std::condition_variable journal_cv;
+static std::thread journal_thread;
+static bool journal_thread_stop = false;
+
+// 共享内存传输会话 - 消费线程从环中取槽位，交给线程池写入目标文件
+struct ShmTransferSession {
+    std::unique_ptr<ShmRing> ring;
+    FileChunk meta;
+    std::shared_ptr<TransferState> state;
+};
+
+// 共享内存传输会话映射 - 使用传输ID作为键
+static std::map<std::string, std::shared_ptr<ShmTransferSession>> shm_sessions;
+static std::mutex shm_sessions_mutex;
+static std::atomic<bool> shm_consumers_stop{false};
+
+// 共享内存消费线程：保留句柄，清理时关闭环（经eventfd唤醒）并等待退出；
+// 已自行退出的线程在建立新通道时回收。受shm_sessions_mutex保护
+struct ShmConsumer {
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> done;
+};
+static std::vector<ShmConsumer> shm_consumers;
+
+// 收尾任务：传输完成时从状态中取出组装所需的数据，交给收尾线程池写盘，接收线程不等待磁盘写入
+struct FinalizeJob {
+    std::shared_ptr<const FileChunk> meta;
+    std::string outdir;
+    TransferStatus status;
+    ChunkStore chunks;                           // 缓存模式下的全部块
+    TransferOutput output;                       // 直写模式下的临时文件
+    std::shared_ptr<TransferJournal> journal;    // 保存完成后删除
 };
 
-// 文件块数据存储映射 - 使用传输ID作为键
-static std::map<std::string, std::map<int, FileChunkCache>> file_chunk_storage;
-static std::mutex chunk_storage_mutex;
+// 收尾线程池：独立于接收线程池，文件组装和重命名在这里进行
+static const size_t FINALIZE_THREAD_COUNT = 2;
+static ThreadPool* finalize_thread_pool = nullptr;
+
+bool assemble_and_save_file(FinalizeJob& job);
+static uint32_t grant_credit(const TransferState& state);
+static void finish_transfer_if_complete(const std::shared_ptr<TransferState>& state);
+
+// 根据文件名和输出目录生成输出路径：从完整路径中提取文件名
+static std::string make_output_path(const std::string& fileName, const std::string& outdir) {
+    std::string actualFileName = fileName;
+    size_t lastSlash = fileName.find_last_of('/');
+    if (lastSlash != std::string::npos) {
+        actualFileName = fileName.substr(lastSlash + 1);
+    }
+    
+    if (outdir == ".") {
+        return actualFileName; // 当前目录
+    }
+    return outdir + "/" + actualFileName;
+}
+
+// 同步路径所在目录：新建或重命名文件后调用，崩溃后目录项不会丢失
+static void sync_parent_dir(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0 || fsync(fd) != 0) {
+        std::cerr << "[FileReceiver] 目录同步失败: " << dir << " " << strerror(errno) << std::endl;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+// 完整写入缓冲区到指定偏移，处理短写
+static bool pwrite_all(int fd, const void* buf, size_t len, off_t offset) {
+    const char* p = static_cast<const char*>(buf);
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// 按传输ID查找传输状态，不存在时用meta和chunk_size新建；已存在的传输沿用原块大小
+static std::shared_ptr<TransferState> find_or_create_state(const FileChunk& meta, const std::string& outdir,
+                                                          uint32_t chunk_size = FILE_CHUNK_SIZE) {
+    TransferShard& shard = transfer_shard(meta.transferId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto& state = shard.states[meta.transferId];
+    if (!state) {
+        state = std::make_shared<TransferState>();
+        state->meta = std::make_shared<const FileChunk>(meta);
+        state->outdir = outdir;
+        state->chunkSize = chunk_size;
+        state->status = TransferStatus(meta.totalChunks, meta.fileLength);
+        state->claimed.reset(new std::atomic<uint64_t>[(std::max(meta.totalChunks, 0) + 63) / 64]());
+        state->remaining = std::max(meta.totalChunks, 0);
+    }
+    return state;
+}
+
+// 按传输ID查找传输状态
+static std::shared_ptr<TransferState> find_state(const std::string& transferId) {
+    TransferShard& shard = transfer_shard(transferId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.states.find(transferId);
+    return it != shard.states.end() ? it->second : nullptr;
+}
+
+// 块是否已写入（索引需已校验）
+static bool chunk_claimed(const TransferState& state, int index) {
+    return (state.claimed[index >> 6].load(std::memory_order_acquire) >> (index & 63)) & 1;
+}
+
+// 数据写入完成后认领块：只有第一次认领返回true并扣减剩余块数，重复块不重复计数（索引需已校验）
+static bool claim_chunk(TransferState& state, int index) {
+    uint64_t bit = 1ULL << (index & 63);
+    if (state.claimed[index >> 6].fetch_or(bit, std::memory_order_acq_rel) & bit) {
+        return false;
+    }
+    state.remaining.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+// 按句柄直接索引会话表
+static std::shared_ptr<TransferState> find_session(uint32_t handle) {
+    size_t slot = handle & 0xFFFF;
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    if (slot >= session_slots.size() || (handle >> 16) != session_slots[slot].generation) {
+        return nullptr;
+    }
+    return session_slots[slot].state;
+}
+
+// 释放传输占用的会话槽位
+static void release_session(TransferState& state) {
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    if (state.handle == 0) {
+        return;
+    }
+    size_t slot = state.handle & 0xFFFF;
+    session_slots[slot].state.reset();
+    session_slots[slot].generation++;
+    free_session_slots.push_back(static_cast<uint32_t>(slot));
+    state.handle = 0;
+}
+
+// 打开path用于写入：create为true时独占新建（文件已存在则失败，errno为EEXIST）
+static std::shared_ptr<OutputFile> open_output_file(const std::string& path, bool create) {
+    int flags = O_WRONLY | O_CLOEXEC | (create ? (O_CREAT | O_EXCL) : 0);
+    int fd = open(path.c_str(), flags, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return std::make_shared<OutputFile>(fd);
+}
+
+// 日志文件名前缀：传输ID的FNV-1a哈希（16位十六进制）
+static std::string journal_hash(const std::string& transferId) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : transferId) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return name;
+}
+
+// 日志文件路径：哈希前缀，attempt大于0时为哈希冲突后的备用名；完整ID记录在文件头中
+static std::string journal_path(const std::string& transferId, int attempt) {
+    std::string name = journal_hash(transferId);
+    if (attempt > 0) {
+        name += "." + std::to_string(attempt);
+    }
+    return TRANSFER_JOURNAL_DIR + "/" + name + ".journal";
+}
+
+// 直写临时文件路径：目标路径加传输ID的哈希，同名文件的并发传输各写各的临时文件
+static std::string make_temp_path(const std::string& finalPath, const std::string& transferId) {
+    return finalPath + "." + journal_hash(transferId) + ".part";
+}
+
+// 读取日志文件头中的传输ID，文件不存在时返回false；文件头不完整（例如正在被创建）时owner为空
+static bool read_journal_owner(const std::string& path, std::string& owner) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno != ENOENT;
+    }
+    JournalHeader header;
+    owner.clear();
+    if (pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) && header.magic == JOURNAL_MAGIC) {
+        owner.assign(header.transferId, strnlen(header.transferId, sizeof(header.transferId)));
+    }
+    close(fd);
+    return true;
+}
+
+// 映射日志文件：create为true时独占新建为size字节（文件已存在则失败，errno为EEXIST），否则按文件实际大小映射
+static std::shared_ptr<TransferJournal> map_journal(const std::string& path, size_t size, bool create) {
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? (O_CREAT | O_EXCL) : 0), 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    
+    struct stat st;
+    if (create ? ftruncate(fd, size) != 0 : (fstat(fd, &st) != 0 || (size = st.st_size) < sizeof(JournalHeader))) {
+        close(fd);
+        return nullptr;
+    }
+    
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return nullptr;
+    }
+    auto journal = std::make_shared<TransferJournal>();
+    journal->path = path;
+    journal->map = map;
+    journal->mapSize = size;
+    return journal;
+}
+
+// 复制传输当前的认领位
+static std::vector<uint64_t> snapshot_claimed(const TransferState& state) {
+    std::vector<uint64_t> words((std::max(state.status.totalChunks, 0) + 63) / 64);
+    for (size_t i = 0; i < words.size(); ++i) {
+        words[i] = state.claimed[i].load(std::memory_order_acquire);
+    }
+    return words;
+}
+
+// 先把目标文件数据落盘，再写入并落盘位图：日志中置位的块在崩溃后一定能在临时文件中读到。
+// words需在数据落盘之前取得，之后才完成写入的块留到下一次刷新
+static bool commit_journal(TransferJournal& journal, int data_fd, const std::vector<uint64_t>& words) {
+    if (fdatasync(data_fd) != 0) {
+        return false;
+    }
+    memcpy(journal.words(), words.data(), words.size() * sizeof(uint64_t));
+    return msync(journal.map, journal.mapSize, MS_SYNC) == 0;
+}
+
+// 为刚创建直写文件的传输建立日志，调用方需持有state.mutex。
+// 这里只创建日志文件并填写文件头，数据、位图和目录项的落盘由日志线程在锁外完成
+static void create_journal(TransferState& state) {
+    const FileChunk& meta = *state.meta;
+    size_t words = (std::max(meta.totalChunks, 0) + 63) / 64;
+    
+    // 文件名只是哈希：已被其他传输占用的名字换备用名，不覆盖别人的日志；本传输遗留的旧日志直接替换
+    std::shared_ptr<TransferJournal> journal;
+    for (int attempt = 0; attempt < JOURNAL_NAME_PROBES && !journal; ++attempt) {
+        std::string path = journal_path(meta.transferId, attempt);
+        std::string owner;
+        if (read_journal_owner(path, owner)) {
+            if (owner != meta.transferId) {
+                continue;
+            }
+            unlink(path.c_str());
+        }
+        journal = map_journal(path, sizeof(JournalHeader) + words * sizeof(uint64_t), true);
+        if (!journal && errno != EEXIST) {
+            break;
+        }
+    }
+    if (!journal) {
+        std::cerr << "[FileReceiver] 无法创建传输日志: " << meta.transferId << " " << strerror(errno) << std::endl;
+        return;
+    }
+    
+    JournalHeader* header = journal->header();
+    header->magic = JOURNAL_MAGIC;
+    header->version = JOURNAL_VERSION;
+    snprintf(header->transferId, sizeof(header->transferId), "%s", meta.transferId);
+    snprintf(header->userid, sizeof(header->userid), "%s", meta.userid);
+    snprintf(header->fileName, sizeof(header->fileName), "%s", meta.fileName);
+    snprintf(header->outdir, sizeof(header->outdir), "%s", state.outdir.c_str());
+    header->fileLength = meta.fileLength;
+    header->fileMode = meta.fileMode;
+    header->chunkSize = state.chunkSize;
+    header->totalChunks = meta.totalChunks;
+    state.journal = journal;
+}
+
+// 把有新块的传输登记到待刷新列表，调用方需持有state.mutex
+static void queue_journal(const std::shared_ptr<TransferState>& state) {
+    if (!state->journal || state->journalQueued) {
+        return;
+    }
+    state->journalQueued = true;
+    std::lock_guard<std::mutex> lock(journal_mutex);
+    journal_pending_states.push_back(state);
+}
+
+// 刷新一个传输的日志，不持有传输锁做磁盘同步。日志和临时文件描述符在锁内一起取得，
+// 收尾线程随后重命名临时文件也不影响这里：描述符仍指向同一个文件，日志已由收尾负责删除
+static void flush_journal(const std::shared_ptr<TransferState>& state) {
+    std::shared_ptr<TransferJournal> journal;
+    std::shared_ptr<OutputFile> file;
+    std::string tempPath;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->journalQueued = false;
+        if (state->finished || !state->journal || !state->output.file) {
+            return;
+        }
+        journal = state->journal;
+        file = state->output.file;
+        tempPath = state->output.tempPath;
+    }
+    
+    // 第一次刷新连同文件头一起提交（包括建立日志时迁移进文件的缓存块），再同步目录使临时文件和日志的目录项落盘
+    std::vector<uint64_t> words = snapshot_claimed(*state);
+    if (!commit_journal(*journal, file->fd, words)) {
+        std::cerr << "[FileReceiver] 传输日志刷新失败: " << state->meta->transferId << " " << strerror(errno) << std::endl;
+        return;
+    }
+    if (!journal->dirSynced) {
+        sync_parent_dir(tempPath);
+        sync_parent_dir(journal->path);
+        journal->dirSynced = true;
+    }
+}
+
+// 日志线程：每隔JOURNAL_FLUSH_INTERVAL_MS把这段时间内有新块的传输成组刷新，停止前再刷新一次
+static void journal_loop() {
+    std::unique_lock<std::mutex> lock(journal_mutex);
+    bool stop = false;
+    while (!stop) {
+        journal_cv.wait_for(lock, std::chrono::milliseconds(JOURNAL_FLUSH_INTERVAL_MS), []() { return journal_thread_stop; });
+        stop = journal_thread_stop;
+        
+        std::vector<std::shared_ptr<TransferState>> pending;
+        pending.swap(journal_pending_states);
+        lock.unlock();
+        for (const auto& state : pending) {
+            flush_journal(state);
+        }
+        lock.lock();
+    }
+}
+
+// 从一个日志文件恢复传输状态：位图按小端字节序即为低位在前的紧凑位图。
+// 文件头无效、文件名与头中的传输ID不符或临时文件已不存在（长度不符）时返回nullptr
+static std::shared_ptr<TransferState> load_journal(const std::string& path) {
+    std::shared_ptr<TransferJournal> journal = map_journal(path, 0, false);
+    if (!journal) {
+        return nullptr;
+    }
+    
+    JournalHeader header = *journal->header();
+    header.transferId[sizeof(header.transferId) - 1] = '\0';
+    header.userid[sizeof(header.userid) - 1] = '\0';
+    header.fileName[sizeof(header.fileName) - 1] = '\0';
+    header.outdir[sizeof(header.outdir) - 1] = '\0';
+    size_t words = (std::max(header.totalChunks, 0) + 63) / 64;
+    if (header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION || header.totalChunks < 0 ||
+        header.chunkSize == 0 || header.fileLength < 0 ||
+        journal->mapSize != sizeof(JournalHeader) + words * sizeof(uint64_t)) {
+        return nullptr;
+    }
+    
+    // 文件名的哈希前缀必须由头中的完整传输ID算出，否则这份日志不属于该传输
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    if (header.transferId[0] == '\0' || name.compare(0, 16, journal_hash(header.transferId)) != 0) {
+        return nullptr;
+    }
+    
+    auto state = std::make_shared<TransferState>();
+    state->outdir = header.outdir;
+    state->output.finalPath = make_output_path(header.fileName, state->outdir);
+    state->output.tempPath = make_temp_path(state->output.finalPath, header.transferId);
+    state->output.created = true;
+    
+    // 临时文件创建时已预分配为文件长度，长度不符说明已被替换，不能续写
+    struct stat st;
+    if (stat(state->output.tempPath.c_str(), &st) != 0 || access(state->output.tempPath.c_str(), W_OK) != 0 ||
+        st.st_size != header.fileLength) {
+        return nullptr;
+    }
+    
+    state->meta = std::make_shared<const FileChunk>(header.userid, 0, header.totalChunks, header.fileName,
+                                                    static_cast<uint64_t>(header.fileLength), header.transferId,
+                                                    static_cast<mode_t>(header.fileMode));
+    state->chunkSize = header.chunkSize;
+    state->status = TransferStatus(header.totalChunks, static_cast<uint64_t>(header.fileLength));
+    
+    TransferStatus& status = state->status;
+    status.chunkBitmap.assignBytes(header.totalChunks, reinterpret_cast<const uint8_t*>(journal->words()));
+    status.receivedChunks = status.chunkBitmap.count();
+    int64_t received = static_cast<int64_t>(status.receivedChunks) * header.chunkSize;
+    if (status.chunkBitmap.test(header.totalChunks - 1)) {
+        received -= static_cast<int64_t>(header.totalChunks) * header.chunkSize - header.fileLength;
+    }
+    status.receivedLength = static_cast<uint64_t>(received);
+    status.isCompleted = status.chunkBitmap.all();
+    
+    state->claimed.reset(new std::atomic<uint64_t>[words]());
+    for (size_t i = 0; i < words; ++i) {
+        state->claimed[i].store(journal->words()[i], std::memory_order_relaxed);
+    }
+    state->remaining = header.totalChunks - status.receivedChunks;
+    journal->dirSynced = true;
+    state->journal = journal;
+    return state;
+}
+
+// 启动时从日志目录重建传输状态表，全部块都已提交的传输直接交给收尾线程池；
+// 超过JOURNAL_EXPIRE_SECONDS未更新的日志视为已放弃的传输，连同临时文件一起删除
+static void recover_transfers() {
+    auto start = std::chrono::steady_clock::now();
+    if (mkdir(TRANSFER_JOURNAL_DIR.c_str(), 0700) != 0 && errno != EEXIST) {
+        std::cerr << "[FileReceiver] 无法创建传输日志目录: " << TRANSFER_JOURNAL_DIR << " " << strerror(errno) << std::endl;
+        return;
+    }
+    DIR* dir = opendir(TRANSFER_JOURNAL_DIR.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+    
+    std::vector<std::shared_ptr<TransferState>> completed;
+    size_t recovered = 0;
+    size_t expired = 0;
+    time_t now = time(nullptr);
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        const std::string suffix = ".journal";
+        if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+        
+        std::string path = TRANSFER_JOURNAL_DIR + "/" + name;
+        std::shared_ptr<TransferState> state = load_journal(path);
+        if (!state) {
+            std::cerr << "[FileReceiver] 丢弃无效的传输日志: " << path << std::endl;
+            unlink(path.c_str());
+            continue;
+        }
+        
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && now - st.st_mtime > JOURNAL_EXPIRE_SECONDS) {
+            std::cerr << "[FileReceiver] 删除过期的传输日志: " << state->meta->transferId << std::endl;
+            unlink(state->output.tempPath.c_str());
+            unlink(path.c_str());
+            ++expired;
+            continue;
+        }
+        
+        const std::string transferId = state->meta->transferId;
+        TransferShard& shard = transfer_shard(transferId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto& slot = shard.states[transferId];
+        if (slot) {
+            continue;
+        }
+        slot = state;
+        ++recovered;
+        if (state->remaining == 0) {
+            completed.push_back(state);
+        }
+    }
+    closedir(dir);
+    if (expired > 0) {
+        sync_parent_dir(TRANSFER_JOURNAL_DIR + "/");
+    }
+    
+    for (const auto& state : completed) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        finish_transfer_if_complete(state);
+    }
+    
+    if (recovered > 0) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "[FileReceiver] 从传输日志恢复 " << recovered << " 个未完成的传输，用时 "
+                  << elapsed.count() << " ms" << std::endl;
+    }
+}
+
+// 获取（必要时创建）传输的直写目标文件描述符，调用方需持有state.mutex，失败返回nullptr。
+// 新建时按文件长度预分配空间，并把已缓存在内存中的块写入文件后释放缓存
+static std::shared_ptr<OutputFile> open_transfer_output(TransferState& state) {
+    if (state.output.created) {
+        if (!state.output.file) {
+            state.output.file = open_output_file(state.output.tempPath, false);
+            if (!state.output.file) {
+                std::cerr << "[FileReceiver] 无法打开临时文件: " << state.output.tempPath << " " << strerror(errno) << std::endl;
+            }
+        }
+        return state.output.file;
+    }
+    
+    const FileChunk& meta = *state.meta;
+    TransferOutput output;
+    output.finalPath = make_output_path(meta.fileName, state.outdir);
+    output.tempPath = make_temp_path(output.finalPath, meta.transferId);
+    std::shared_ptr<OutputFile> file = open_output_file(output.tempPath, true);
+    if (!file && errno == EEXIST) {
+        // 临时文件名含本传输ID的哈希，已存在的只能是本传输在建立日志前崩溃留下的，内容不可信，重新创建
+        unlink(output.tempPath.c_str());
+        file = open_output_file(output.tempPath, true);
+    }
+    if (!file) {
+        std::cerr << "[FileReceiver] 无法创建临时文件: " << output.tempPath << " " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    
+    // 预分配文件空间，后续按偏移写入不再扩展文件；文件系统不支持时只设置文件长度
+    if (meta.fileLength > 0 && fallocate(file->fd, 0, 0, meta.fileLength) != 0 &&
+        ftruncate(file->fd, meta.fileLength) != 0) {
+        std::cerr << "[FileReceiver] 设置文件长度失败: " << strerror(errno) << std::endl;
+    }
+    
+    // 迁移已缓存的块
+    if (!state.chunks.empty()) {
+        for (const ChunkRange& range : state.status.chunkBitmap.setRanges()) {
+            uint64_t offset = static_cast<uint64_t>(range.first) * state.chunkSize;
+            uint64_t end = std::min<uint64_t>(static_cast<uint64_t>(range.first + range.count) * state.chunkSize,
+                                              meta.fileLength);
+            while (offset < end) {
+                const char* data = nullptr;
+                size_t n = state.chunks.read(offset, end - offset, &data);
+                if (n == 0 || !pwrite_all(file->fd, data, n, offset)) {
+                    std::cerr << "[FileReceiver] 迁移缓存块失败: " << range.first << std::endl;
+                    break;
+                }
+                offset += n;
+            }
+        }
+    }
+    state.chunks.clear();
+    
+    output.created = true;
+    output.file = file;
+    state.output = output;
+    create_journal(state);
+    return file;
+}
+
+// 把传输登记到待确认列表，调用方需持有state.mutex
+static void queue_ack(const std::shared_ptr<TransferState>& state) {
+    if (state->ackQueued) {
+        return;
+    }
+    state->ackQueued = true;
+    std::lock_guard<std::mutex> lock(ack_mutex);
+    ack_pending_states.push_back(state);
+}
+
+// 记录新收到的块范围等待确认，与上一个范围相邻时合并，调用方需持有state.mutex
+static void record_ack(const std::shared_ptr<TransferState>& state, int first_index, int count) {
+    std::vector<ChunkRange>& ranges = state->pendingAck;
+    if (!ranges.empty() && ranges.back().first + ranges.back().count == first_index) {
+        ranges.back().count += count;
+    } else {
+        ranges.push_back({first_index, count});
+    }
+    queue_ack(state);
+    queue_journal(state);
+}
+
+// 数据写入完成后认领从first_index开始、覆盖length字节的连续块，返回新认领的(索引, 长度)，不需要持锁
+static std::vector<std::pair<int, size_t>> claim_written_range(TransferState& state, int first_index, size_t length) {
+    std::vector<std::pair<int, size_t>> claimed;
+    size_t offset = 0;
+    for (int index = first_index; offset < length; ++index) {
+        size_t chunk_len = std::min(static_cast<size_t>(state.chunkSize), length - offset);
+        if (index >= 0 && index < state.status.totalChunks && claim_chunk(state, index)) {
+            claimed.emplace_back(index, chunk_len);
+        }
+        offset += chunk_len;
+    }
+    return claimed;
+}
 
-bool assemble_and_save_file(const std::string& transferId, const std::string& fileName, const mode_t fileMode, const std::string& outdir, const TransferStatus& status);
+// 把已写入并认领的块记入查询位图和待确认范围，然后检查是否完成，调用方需持有state.mutex。
+// 传输已完成时位图已置满，只补记确认
+static void mark_claimed_chunks(const std::shared_ptr<TransferState>& state, const std::vector<std::pair<int, size_t>>& chunks) {
+    for (const auto& chunk : chunks) {
+        state->status.markChunkReceived(chunk.first, chunk.second);
+        record_ack(state, chunk.first, 1);
+    }
+    finish_transfer_if_complete(state);
+}
+
+// 从first_index开始的length字节是否完整落在文件范围内
+static bool valid_write_range(const TransferState& state, int first_index, size_t length) {
+    int64_t end = static_cast<int64_t>(first_index) * state.chunkSize + static_cast<int64_t>(length);
+    if (first_index < 0 || first_index >= state.status.totalChunks || end > static_cast<int64_t>(state.status.fileLength)) {
+        std::cerr << "[FileReceiver] 丢弃超出文件范围的数据: " << first_index << " 长度: " << length << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 生成一个传输的确认：快照时从位图压缩出全部已接收范围，否则取出累计的增量范围，调用方需持有state.mutex
+static ChunkAck take_ack(TransferState& state) {
+    ChunkAck ack;
+    ack.transferId = state.meta->transferId;
+    ack.snapshot = state.ackSnapshot;
+    if (state.ackSnapshot) {
+        ack.ranges = state.status.chunkBitmap.setRanges();
+    } else {
+        ack.ranges.swap(state.pendingAck);
+    }
+    state.pendingAck.clear();
+    state.ackSnapshot = false;
+    state.ackQueued = false;
+    return ack;
+}
+
+// 确认线程：每隔SACK_INTERVAL_MS取出待确认的传输，逐个生成确认并交给回调推送
+static void ack_loop() {
+    std::unique_lock<std::mutex> lock(ack_mutex);
+    while (!ack_thread_stop) {
+        ack_cv.wait_for(lock, std::chrono::milliseconds(SACK_INTERVAL_MS));
+        if (ack_pending_states.empty()) {
+            continue;
+        }
+        
+        std::vector<std::shared_ptr<TransferState>> pending;
+        pending.swap(ack_pending_states);
+        ChunkAckCallback callback = chunk_ack_callback;
+        lock.unlock();
+        
+        for (const auto& state : pending) {
+            ChunkAck ack;
+            {
+                std::lock_guard<std::mutex> state_lock(state->mutex);
+                ack = take_ack(*state);
+            }
+            ack.credit = grant_credit(*state);
+            if (callback) {
+                callback(ack);
+            }
+        }
+        lock.lock();
+    }
+}
+
+// 收尾任务：组装并保存文件，然后删除日志并从映射和会话表中移除传输。
+// 保存完成前传输仍可被查询到（已完成状态），断点续传不会误判为丢失。
+// 保存失败时把数据放回传输状态，日志、会话和临时文件都保留，传输重新打开或服务端重启恢复时再次收尾
+static void finalize_transfer(std::shared_ptr<TransferState> state, std::shared_ptr<FinalizeJob> job) {
+    const FileChunk& meta = *job->meta;
+    if (!assemble_and_save_file(*job)) {
+        std::cerr << "[FileReceiver] 文件保存失败，保留传输等待重试: " << meta.fileName << std::endl;
+        std::lock_guard<std::mutex> lock(state->mutex);
+        std::swap(state->chunks, job->chunks);
+        state->output = job->output;
+        state->journal = job->journal;
+        state->status.statusCode = 2;
+        state->finished = false;
+        return;
+    }
+    std::cout << "[FileReceiver] 文件保存成功: " << meta.fileName << std::endl;
+    if (job->journal) {
+        unlink(job->journal->path.c_str());
+    }
+    
+    release_session(*state);
+    TransferShard& shard = transfer_shard(meta.transferId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.states.find(meta.transferId);
+    if (it != shard.states.end() && it->second == state) {
+        shard.states.erase(it);
+    }
+}
+
+// 检查传输是否完成（全部块已认领），完成则取出缓存块和目标文件交给收尾线程池，调用方需持有state.mutex。
+// 由finished保证只触发一次；标记完成后迟到的块直接丢弃，不会再写入目标文件
+static void finish_transfer_if_complete(const std::shared_ptr<TransferState>& state) {
+    if (state->finished || state->remaining.load(std::memory_order_acquire) != 0) {
+        return;
+    }
+    state->finished = true;
+    
+    // 其他线程可能已写入并认领了块但还没来得及更新位图，全部块已认领时直接把状态置为完成
+    TransferStatus& status = state->status;
+    status.chunkBitmap.setRange(0, status.totalChunks);
+    status.receivedChunks = status.totalChunks;
+    status.receivedLength = status.fileLength;
+    status.isCompleted = true;
+    
+    auto job = std::make_shared<FinalizeJob>();
+    job->meta = state->meta;
+    job->outdir = state->outdir;
+    job->status = state->status;
+    std::swap(job->chunks, state->chunks);
+    job->output = state->output;
+    state->output = TransferOutput();
+    job->journal = std::move(state->journal);
+    
+    std::cout << "[FileReceiver] 文件传输完成: " << job->meta->transferId 
+              << " (" << state->status.receivedChunks << "/" << state->status.totalChunks << ")" << std::endl;
+    
+    if (finalize_thread_pool != nullptr) {
+        finalize_thread_pool->enqueue(finalize_transfer, state, job);
+    } else {
+        finalize_transfer(state, job);
+    }
+}
 
 // 初始化文件接收器
 int init_file_receiver(size_t thread_count, size_t memory_pool_blocks) {
@@ -59,6 +916,17 @@ int init_file_receiver(size_t thread_count, size_t memory_pool_blocks) {
     try {
         // 创建线程池
         receiver_thread_pool = new ThreadPool(thread_count);
+        finalize_thread_pool = new ThreadPool(FINALIZE_THREAD_COUNT);
+        shm_consumers_stop = false;
+        
+        // 启动选择性确认线程
+        ack_thread_stop = false;
+        ack_thread = std::thread(ack_loop);
+        
+        // 从传输日志恢复上次未完成的传输，然后启动日志刷新线程
+        recover_transfers();
+        journal_thread_stop = false;
+        journal_thread = std::thread(journal_loop);
         
         // 创建内存池 - 用于流量控制和内存管理
         server_memory_pool = std::make_unique<MemoryPool>(FILE_CHUNK_SIZE, memory_pool_blocks);
@@ -72,12 +940,66 @@ int init_file_receiver(size_t thread_count, size_t memory_pool_blocks) {
     }
 }
 
-// 清理文件接收器资源
+// 停止选择性确认：清除回调并等待确认线程退出，之后不会再调用回调，也不再读取线程池
+static void stop_ack_thread() {
+    {
+        std::lock_guard<std::mutex> lock(ack_mutex);
+        ack_thread_stop = true;
+        ack_pending_states.clear();
+        chunk_ack_callback = nullptr;
+    }
+    ack_cv.notify_all();
+    if (ack_thread.joinable()) {
+        ack_thread.join();
+    }
+}
+
+void stop_chunk_acks() {
+    stop_ack_thread();
+}
+
+// 清理文件接收器资源：调用方需先保证不再有新的接收调用（先销毁DBusAdapter）。
+// 顺序为：确认线程 -> 接收线程池 -> 收尾线程池 -> 日志线程
 int cleanup_file_receiver() {  
     if (receiver_thread_pool != nullptr) {
+        // 确认线程会读取接收线程池的队列深度，先于线程池停止
+        stop_ack_thread();
+        
+        // 通知共享内存消费线程退出：关闭环会写数据eventfd唤醒等待中的消费线程。
+        // 消费线程向接收线程池投递任务，必须在线程池销毁前全部退出
+        shm_consumers_stop = true;
+        std::vector<ShmConsumer> consumers;
+        {
+            std::lock_guard<std::mutex> lock(shm_sessions_mutex);
+            for (auto& entry : shm_sessions) {
+                entry.second->ring->close();
+            }
+            consumers.swap(shm_consumers);
+        }
+        for (ShmConsumer& consumer : consumers) {
+            if (consumer.thread.joinable()) {
+                consumer.thread.join();
+            }
+        }
+        
+        // 排空接收线程池：已入队的批次全部写完，其中完成的传输会投递收尾任务
         delete receiver_thread_pool;
         receiver_thread_pool = nullptr;
         
+        // 接收线程全部退出后再停止收尾线程池，已排队的文件保存全部完成
+        delete finalize_thread_pool;
+        finalize_thread_pool = nullptr;
+        
+        // 所有写入结束后停止日志线程，退出前提交最后一组
+        {
+            std::lock_guard<std::mutex> lock(journal_mutex);
+            journal_thread_stop = true;
+        }
+        journal_cv.notify_all();
+        if (journal_thread.joinable()) {
+            journal_thread.join();
+        }
+        
         // 清理内存池
         server_memory_pool.reset();
         
@@ -88,137 +1010,509 @@ int cleanup_file_receiver() {
     return -1;
 }
 
-// 处理接收到的文件块
-void process_file_chunk(const FileChunk& chunk, const std::string& outdir) {
-    // 调试信息：打印接收到的文件块信息
-    // std::cout << "[FileReceiver] 接收到文件块: " << std::endl;
-    // std::cout << "  transferId: " << chunk.transferId << std::endl;
-    // std::cout << "  userid: " << chunk.userid << std::endl;
-    // std::cout << "  fileName: " << chunk.fileName << std::endl;
-    // std::cout << "  fileIndex: " << chunk.fileIndex << std::endl;
-    // std::cout << "  totalChunks: " << chunk.totalChunks << std::endl;
-    // std::cout << "  fileLength: " << chunk.fileLength << std::endl;
-    // std::cout << "  chunkLength: " << chunk.chunkLength << std::endl;
-    // std::cout << "  isLastChunk: " << std::boolalpha << chunk.isLastChunk << std::endl;
-    
-    // 内存使用控制：检查是否超过服务器内存限制
-    if (current_memory_usage + chunk.chunkLength > MAX_SERVER_MEMORY_BYTES) {
-        std::unique_lock<std::mutex> lock(memory_mutex_);
-        
-        // 等待内存释放
-        memory_cv_.wait(lock, [&chunk]() {
-            return current_memory_usage + chunk.chunkLength <= MAX_SERVER_MEMORY_BYTES;
-        });
+// 一批视图的负载总字节数
+static size_t views_bytes(const std::vector<ChunkView>& views) {
+    size_t bytes = 0;
+    for (const ChunkView& view : views) {
+        bytes += view.length;
+    }
+    return bytes;
+}
+
+// 批次进入线程池队列前登记内存占用，超出预算时拒绝；遵守额度的发送端不会触发，
+// 只有不支持流控的旧发送端会收到失败并按原有逻辑重试（队列为空时单批总是放行）
+static bool reserve_queued_bytes(size_t bytes) {
+    size_t used = current_memory_usage.load();
+    do {
+        if (used > 0 && used + bytes > MAX_SERVER_MEMORY_BYTES) {
+            return false;
+        }
+    } while (!current_memory_usage.compare_exchange_weak(used, used + bytes));
+    return true;
+}
+
+// 批次处理完成（或入队失败）后释放登记的内存
+static void release_queued_bytes(size_t bytes) {
+    current_memory_usage -= bytes;
+}
+
+// 会话批次入队：同时登记到传输自身，第一批积压时计入活跃传输数。
+// 空批次不参与计数，否则其释放会在积压清零后再减一次活跃传输数
+static bool reserve_transfer_bytes(TransferState& state, size_t bytes) {
+    if (bytes == 0) {
+        return true;
+    }
+    if (!reserve_queued_bytes(bytes)) {
+        return false;
+    }
+    if (state.queuedBytes.fetch_add(bytes) == 0) {
+        ++active_transfers;
     }
+    return true;
+}
+
+static void release_transfer_bytes(TransferState& state, size_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    if (state.queuedBytes.fetch_sub(bytes) == bytes) {
+        --active_transfers;
+    }
+    release_queued_bytes(bytes);
+}
+
+// 计算授予传输的在途额度（字节）：内存预算在活跃传输间均分并扣除该传输已积压的部分，
+// 不超过全局剩余预算；线程池队列越深额度越小，积压到上限时为0
+static uint32_t grant_credit(const TransferState& state) {
+    size_t used = current_memory_usage.load();
+    size_t available = used < MAX_SERVER_MEMORY_BYTES ? MAX_SERVER_MEMORY_BYTES - used : 0;
+    size_t own = state.queuedBytes.load();
+    size_t senders = std::max<size_t>(1, active_transfers.load() + (own == 0 ? 1 : 0));
+    size_t share = MAX_SERVER_MEMORY_BYTES / senders;
+    size_t credit = std::min(share > own ? share - own : 0, available);
     
-    // 更新内存使用量
-    current_memory_usage += chunk.chunkLength;
+    if (receiver_thread_pool != nullptr) {
+        size_t depth = receiver_thread_pool->get_task_queue_size();
+        size_t limit = receiver_thread_pool->get_thread_count() * MAX_QUEUED_TASKS_PER_THREAD;
+        credit = depth >= limit ? 0 : credit / limit * (limit - depth);
+    }
+    return static_cast<uint32_t>(std::min(credit, MAX_TRANSFER_CREDIT_BYTES));
+}
+
+// 块视图是否可以写入：索引越界、负载超过协商块大小或超出文件长度的块直接丢弃，避免写到文件范围之外。
+// 逐块和批量接口的totalChunks、fileLength都由客户端提供，两者不一致时以文件长度为准
+static bool valid_chunk_view(const TransferState& state, const ChunkView& view) {
+    int64_t end = static_cast<int64_t>(view.fileIndex) * state.chunkSize + static_cast<int64_t>(view.length);
+    if (view.fileIndex < 0 || view.fileIndex >= state.status.totalChunks || view.length > state.chunkSize ||
+        end > static_cast<int64_t>(state.status.fileLength)) {
+        std::cerr << "[FileReceiver] 丢弃无效文件块: " << view.fileIndex << " 长度: " << view.length << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 缓存模式：把一批块视图拷入传输的块缓存，调用方需持有state.mutex
+static void cache_transfer_views(const std::shared_ptr<TransferState>& state, const std::vector<ChunkView>& views) {
+    for (const ChunkView& view : views) {
+        // 缓存模式全程持有state.mutex，先判重再存入，存入成功后才认领
+        if (!valid_chunk_view(*state, view) || chunk_claimed(*state, view.fileIndex)) {
+            continue;
+        }
+        if (!state->chunks.put(view.fileIndex, state->chunkSize, state->status.fileLength, view.data, view.length)) {
+            std::cerr << "[FileReceiver] 文件块超出缓存范围: " << view.fileIndex << std::endl;
+            continue;
+        }
+        claim_chunk(*state, view.fileIndex);
+        
+        // 标记块已接收，并记入待确认范围
+        state->status.markChunkReceived(view.fileIndex, view.length);
+        record_ack(state, view.fileIndex, 1);
+    }
     
+    // 如果文件组装完成，保存文件并清理资源
+    finish_transfer_if_complete(state);
+}
+
+// 把一批文件块视图写入传输：直写模式或已有目标文件时按偏移直接写入，否则缓存视图，负载在此之前不做拷贝
+// 内存占用由入队方登记，处理完成后由调用方释放
+static void process_transfer_views(const std::shared_ptr<TransferState>& state, const std::vector<ChunkView>& views) {
     // 检查内存池是否可用
     if (!server_memory_pool) {
         std::cerr << "Memory pool not available for file chunk processing." << std::endl;
-        current_memory_usage -= chunk.chunkLength; // 回滚内存使用量
         return;
     }
     
-    // 使用传输ID作为键，支持断点续传
-    std::string key = std::string(chunk.transferId);
+    std::shared_ptr<OutputFile> output;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->finished) {
+            return;
+        }
+        if (direct_write_enabled || state->output.created) {
+            output = open_transfer_output(*state);
+        }
+        if (!output) {
+            cache_transfer_views(state, views);
+            return;
+        }
+    }
+    
+    // 直写：写盘不持有传输锁，同一传输的多个批次可以并行写入；块写完后才认领，
+    // 剩余块数归零时所有数据都已落到文件中
+    std::vector<std::pair<int, size_t>> written;
+    for (const ChunkView& view : views) {
+        if (!valid_chunk_view(*state, view) || chunk_claimed(*state, view.fileIndex)) {
+            continue;
+        }
+        
+        off_t offset = static_cast<off_t>(view.fileIndex) * state->chunkSize;
+        if (!pwrite_all(output->fd, view.data, view.length, offset)) {
+            std::cerr << "[FileReceiver] 写入文件块失败: " << view.fileIndex << " " << strerror(errno) << std::endl;
+            continue;
+        }
+        if (claim_chunk(*state, view.fileIndex)) {
+            written.emplace_back(view.fileIndex, view.length);
+        }
+    }
+    if (written.empty()) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(state->mutex);
+    mark_claimed_chunks(state, written);
+}
+
+// 处理接收到的一批文件块视图（同一传输），按视图携带的元数据找到传输状态
+void process_chunk_views(const std::vector<ChunkView>& views, const std::string& outdir) {
+    if (!views.empty()) {
+        // 使用传输ID作为键，支持断点续传
+        process_transfer_views(find_or_create_state(*views.front().meta, outdir), views);
+    }
+    release_queued_bytes(views_bytes(views));
+}
+
+// 处理按会话句柄接收的一批文件块视图，完成后归还该传输的额度
+static void process_session_views(const std::shared_ptr<TransferState>& state, const std::vector<ChunkView>& views) {
+    process_transfer_views(state, views);
+    release_transfer_bytes(*state, views_bytes(views));
+}
 
-    // std::cout << "[process_file_chunk] key = " << key << std::endl;
+// 处理FD传递的文件范围：从源描述符直接拷贝到目标文件，不经过内存缓存。
+// 只在取目标文件和标记块时持有传输锁，同一传输的多个范围可以并行拷贝
+void process_file_range(const FileChunk& meta, int src_fd, off_t src_offset, size_t length, const std::string& outdir) {
+    std::shared_ptr<TransferState> state = find_or_create_state(meta, outdir);
     
-    // 存储文件块数据
+    std::shared_ptr<OutputFile> output;
     {
-        std::lock_guard<std::mutex> lock(chunk_storage_mutex);
-        FileChunkCache cache;
-        cache.chunkIndex = chunk.fileIndex;
-        cache.data.assign(chunk.data, chunk.data + chunk.chunkLength);
-        cache.timestamp = std::chrono::steady_clock::now();
-        file_chunk_storage[key][chunk.fileIndex] = cache;
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->finished) {
+            output = open_transfer_output(*state);
+        }
     }
     
-    // 添加到文件传输状态
-    {
-        std::lock_guard<std::mutex> lock(transfer_states_mutex);
+    off_t dst_offset = static_cast<off_t>(meta.fileIndex) * state->chunkSize;
+    if (output && valid_write_range(*state, meta.fileIndex, length)) {
+        // 优先使用copy_file_range在内核内拷贝，不支持时回退到pread/pwrite
+        off_t in_off = src_offset;
+        off_t out_off = dst_offset;
+        size_t remaining = length;
+        while (remaining > 0) {
+            ssize_t n = copy_file_range(src_fd, &in_off, output->fd, &out_off, remaining, 0);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                break;
+            }
+            remaining -= n;
+        }
         
-        auto it = file_transfer_states.find(key);
-        if (it == file_transfer_states.end()) {
-            // 新传输，初始化TransferStatus
-            file_transfer_states[key] = TransferStatus(chunk.totalChunks, chunk.fileLength);
+        std::vector<char> buffer;
+        while (remaining > 0) {
+            if (buffer.empty()) buffer.resize(64 * 1024);
+            ssize_t n = pread(src_fd, buffer.data(), std::min(buffer.size(), remaining), in_off);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0 || !pwrite_all(output->fd, buffer.data(), n, out_off)) {
+                break;
+            }
+            in_off += n;
+            out_off += n;
+            remaining -= n;
         }
         
-        // 标记块已接收
-        file_transfer_states[key].markChunkReceived(chunk.fileIndex, chunk.chunkLength);
+        if (remaining == 0) {
+            // 数据写完后认领范围内的块，再持锁标记
+            std::vector<std::pair<int, size_t>> claimed = claim_written_range(*state, meta.fileIndex, length);
+            if (!claimed.empty()) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                mark_claimed_chunks(state, claimed);
+            }
+        } else {
+            std::cerr << "[FileReceiver] 文件范围拷贝失败: " << meta.transferId << " " << strerror(errno) << std::endl;
+        }
     }
+    close(src_fd);
+}
+
+// 处理共享内存环中的一个槽位：负载直接从共享内存写入目标文件，写完立即归还槽位。
+// 写盘不持有传输锁，多个槽位可以并行写入
+static void process_shm_slot(std::shared_ptr<ShmTransferSession> session, ShmSlot slot) {
+    const std::shared_ptr<TransferState>& state = session->state;
     
-    // 检查是否完成
-    bool is_complete;
-    {   
-        std::lock_guard<std::mutex> lock(transfer_states_mutex);
-        auto it = file_transfer_states.find(key);
-        is_complete = (it != file_transfer_states.end() && it->second.isCompleted);
+    std::shared_ptr<OutputFile> output;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->finished) {
+            output = open_transfer_output(*state);
+        }
     }
     
-    // 如果文件组装完成，保存文件并清理资源
-    if (is_complete) {
-        std::lock_guard<std::mutex> lock(transfer_states_mutex);
-        auto it = file_transfer_states.find(key);
-        if (it != file_transfer_states.end()) {
-            TransferStatus& final_status = it->second;
-            
-            if (final_status.isCompleted) {
-                std::cout << "[FileReceiver] 文件传输完成: " << key 
-                          << " (" << final_status.receivedChunks << "/" << final_status.totalChunks << ")" << std::endl;
-                
-                std::cout << "process_file_chunk] fileMode:" << chunk.fileMode << std::endl;
-                // 组装并保存文件
-                if (assemble_and_save_file(key, std::string(chunk.fileName), chunk.fileMode, outdir, final_status)) {
-                    std::cout << "[FileReceiver] 文件保存成功: " << chunk.fileName << std::endl;
-                } else {
-                    std::cerr << "[FileReceiver] 文件保存失败: " << chunk.fileName << std::endl;
-                }
-                
-                // 从映射中移除完成的传输状态
-                file_transfer_states.erase(key);
-                
-                // 释放内存并通知等待的线程
-                current_memory_usage -= chunk.chunkLength;
-                memory_cv_.notify_all();
-            } else {
-                std::vector<int> missing = final_status.getMissingChunks();
-                std::cout << "[FileReceiver] 传输 " << key << " 缺失块数: " << missing.size() << std::endl;
-                
-                // 处理未完成的情况也要释放内存
-                current_memory_usage -= chunk.chunkLength;
-                memory_cv_.notify_all();
+    if (output && valid_write_range(*state, slot.firstIndex, slot.length)) {
+        off_t offset = static_cast<off_t>(slot.firstIndex) * state->chunkSize;
+        if (pwrite_all(output->fd, slot.data, slot.length, offset)) {
+            std::vector<std::pair<int, size_t>> claimed = claim_written_range(*state, slot.firstIndex, slot.length);
+            if (!claimed.empty()) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                mark_claimed_chunks(state, claimed);
             }
+        } else {
+            std::cerr << "[FileReceiver] 写入共享内存槽位失败: " << slot.firstIndex << " " << strerror(errno) << std::endl;
+        }
+    }
+    session->ring->release(slot);
+}
+
+// 共享内存消费线程：按顺序取出已发布的槽位并分派到线程池，生产端关闭且取空后退出
+static void shm_consumer_loop(std::shared_ptr<ShmTransferSession> session, std::shared_ptr<std::atomic<bool>> done) {
+    std::string key = std::string(session->meta.transferId);
+    
+    while (!shm_consumers_stop) {
+        ShmSlot slot;
+        if (session->ring->consume(slot, 100)) {
+            if (receiver_thread_pool == nullptr) {
+                session->ring->release(slot);
+                break;
+            }
+            receiver_thread_pool->enqueue(process_shm_slot, session, slot);
+        } else if (session->ring->drained()) {
+            break;
         }
-    } else {
-        // 如果传输未完成，也需要在适当的时候释放内存
-        // 这里我们假设在缓存处理完成后释放内存
-        current_memory_usage -= chunk.chunkLength;
-        memory_cv_.notify_all();
     }
+    
+    {
+        std::lock_guard<std::mutex> lock(shm_sessions_mutex);
+        auto it = shm_sessions.find(key);
+        if (it != shm_sessions.end() && it->second == session) {
+            shm_sessions.erase(it);
+        }
+    }
+    std::cout << "[FileReceiver] 共享内存传输通道关闭: " << key << std::endl;
+    *done = true;
 }
 
-// 接收文件块并添加到线程池处理
+// 接收文件块并添加到线程池处理：复制一份块作为视图的持有者
 int receive_file_chunk(const FileChunk& chunk, const std::string& outdir) {
+    auto owned = std::make_shared<const FileChunk>(chunk);
+    
+    ChunkView view;
+    view.meta = owned;
+    view.owner = owned;
+    view.fileIndex = owned->fileIndex;
+    view.data = owned->data;
+    view.length = std::min(owned->chunkLength, sizeof(owned->data));
+    return receive_chunk_views({view}, outdir);
+}
+
+// 接收一批文件块视图并添加到线程池处理，线程池任务只复制视图本身
+int receive_chunk_views(const std::vector<ChunkView>& views, const std::string& outdir) {
     if (receiver_thread_pool == nullptr) {
         std::cerr << "File receiver not initialized. Call init_file_receiver first." << std::endl;
         return -1;
     }
     
+    // 超出内存预算时拒绝，发送端稍后重试
+    if (!reserve_queued_bytes(views_bytes(views))) {
+        std::cerr << "[FileReceiver] 内存预算已满，拒绝文件块批次" << std::endl;
+        return -1;
+    }
+    
     // 将文件块处理任务添加到线程池
-    receiver_thread_pool->enqueue(process_file_chunk, chunk, outdir);
+    receiver_thread_pool->enqueue(process_chunk_views, views, outdir);
+    return 0;
+}
+
+// 为传输分配会话句柄，已有句柄时直接返回；会话数达到上限时返回0
+static uint32_t assign_session(const std::shared_ptr<TransferState>& state) {
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    if (state->handle != 0) {
+        return state->handle;
+    }
+    
+    uint32_t slot;
+    if (!free_session_slots.empty()) {
+        slot = free_session_slots.back();
+        free_session_slots.pop_back();
+    } else if (session_slots.size() < MAX_TRANSFER_SESSIONS) {
+        slot = static_cast<uint32_t>(session_slots.size());
+        session_slots.emplace_back();
+    } else {
+        std::cerr << "[FileReceiver] 传输会话数已达上限: " << MAX_TRANSFER_SESSIONS << std::endl;
+        return 0;
+    }
+    
+    // 槽位0的第0代会得到句柄0，跳过该代保证句柄非0
+    SessionSlot& entry = session_slots[slot];
+    if (slot == 0 && entry.generation == 0) {
+        entry.generation = 1;
+    }
+    entry.state = state;
+    state->handle = (static_cast<uint32_t>(entry.generation) << 16) | slot;
+    return state->handle;
+}
+
+// 打开传输会话：协商块大小、登记元数据并分配句柄。
+// 同一传输重复打开时返回已有句柄和原块大小，断点续传的块索引保持一致
+TransferSession open_transfer(const FileChunk& meta, uint32_t chunk_size, const std::string& outdir) {
+    if (chunk_size == 0) {
+        chunk_size = DEFAULT_CHUNK_SIZE;
+    }
+    chunk_size = std::max<uint32_t>(MIN_CHUNK_SIZE, std::min<uint32_t>(chunk_size, MAX_CHUNK_SIZE));
+    
+    // 总块数由服务端按协商后的块大小计算，块索引是int，块数超出范围时拒绝
+    uint64_t total_chunks = meta.fileLength / chunk_size + (meta.fileLength % chunk_size != 0 ? 1 : 0);
+    if (total_chunks > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+        std::cerr << "[FileReceiver] 文件过大，块数超出范围: " << meta.fileLength << std::endl;
+        return TransferSession();
+    }
+    FileChunk session_meta = meta;
+    session_meta.totalChunks = static_cast<int>(total_chunks);
+    std::shared_ptr<TransferState> state = find_or_create_state(session_meta, outdir, chunk_size);
+    
+    TransferSession session;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        session.chunkSize = state->chunkSize;
+        session.totalChunks = state->status.totalChunks;
+        
+        // 打开（或重新打开）会话后推送一次完整的已接收集合，发送端据此只补发缺失的块
+        state->ackSnapshot = true;
+        queue_ack(state);
+    }
+    session.credit = grant_credit(*state);
+    session.handle = assign_session(state);
+    
+    // 没有块的空文件在打开时就已完成；全部块都已收到但上次保存失败的传输，重新打开时再次收尾。
+    // 句柄已分配，收尾会一并释放
+    if (session.handle != 0) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        finish_transfer_if_complete(state);
+    }
+    return session;
+}
+
+// 关闭传输会话：只释放句柄，已接收的状态保留供断点续传查询
+int close_transfer(uint32_t handle) {
+    std::shared_ptr<TransferState> state = find_session(handle);
+    if (!state) {
+        return -1;
+    }
+    release_session(*state);
+    return 0;
+}
+
+// 按会话句柄接收一批文件块视图，视图不需要携带元数据；credit返回入队后授予该传输的在途额度
+int receive_session_chunks(uint32_t handle, const std::vector<ChunkView>& views, uint32_t* credit) {
+    if (credit) {
+        *credit = 0;
+    }
+    if (receiver_thread_pool == nullptr) {
+        std::cerr << "File receiver not initialized. Call init_file_receiver first." << std::endl;
+        return -1;
+    }
+    
+    std::shared_ptr<TransferState> state = find_session(handle);
+    if (!state) {
+        std::cerr << "[FileReceiver] 无效的传输会话句柄: " << handle << std::endl;
+        return -1;
+    }
+    
+    // 空批次只用于查询额度，不入队
+    int ret = 0;
+    if (!views.empty()) {
+        if (reserve_transfer_bytes(*state, views_bytes(views))) {
+            receiver_thread_pool->enqueue(process_session_views, state, views);
+        } else {
+            std::cerr << "[FileReceiver] 内存预算已满，拒绝会话批次: " << handle << std::endl;
+            ret = -1;
+        }
+    }
+    
+    if (credit) {
+        *credit = grant_credit(*state);
+    }
+    return ret;
+}
+
+// 接收FD传递的文件范围并添加到线程池处理，src_fd的所有权转移给接收器
+int receive_file_range(const FileChunk& meta, int src_fd, off_t src_offset, size_t length, const std::string& outdir) {
+    if (receiver_thread_pool == nullptr) {
+        std::cerr << "File receiver not initialized. Call init_file_receiver first." << std::endl;
+        close(src_fd);
+        return -1;
+    }
+    
+    receiver_thread_pool->enqueue(process_file_range, meta, src_fd, src_offset, length, outdir);
+    return 0;
+}
+
+// 建立共享内存传输通道：映射对端的环形缓冲区并启动消费线程
+int open_shm_transfer(const FileChunk& meta, int mem_fd, int data_efd, int space_efd, const std::string& outdir) {
+    if (receiver_thread_pool == nullptr) {
+        std::cerr << "File receiver not initialized. Call init_file_receiver first." << std::endl;
+        close(mem_fd);
+        close(data_efd);
+        close(space_efd);
+        return -1;
+    }
+    
+    auto session = std::make_shared<ShmTransferSession>();
+    session->ring = ShmRing::attach(mem_fd, data_efd, space_efd);
+    if (!session->ring) {
+        close(mem_fd);
+        close(data_efd);
+        close(space_efd);
+        return -1;
+    }
+    session->meta = meta;
+    session->state = find_or_create_state(meta, outdir);
+    
+    std::string key = std::string(meta.transferId);
+    {
+        std::lock_guard<std::mutex> lock(shm_sessions_mutex);
+        auto it = shm_sessions.find(key);
+        if (it != shm_sessions.end()) {
+            // 同一传输重新建立通道时关闭旧的环，旧消费线程取空后自行退出
+            it->second->ring->close();
+        }
+        shm_sessions[key] = session;
+        
+        // 回收已退出的消费线程
+        for (auto it = shm_consumers.begin(); it != shm_consumers.end();) {
+            if (*it->done) {
+                it->thread.join();
+                it = shm_consumers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        
+        ShmConsumer consumer;
+        consumer.done = std::make_shared<std::atomic<bool>>(false);
+        consumer.thread = std::thread(shm_consumer_loop, session, consumer.done);
+        shm_consumers.push_back(std::move(consumer));
+    }
+
+    std::cout << "[FileReceiver] 共享内存传输通道建立: " << key 
+              << " 槽位大小: " << session->ring->slot_size() << std::endl;
+    return 0;
+}
+
+// 结束共享内存传输：标记环关闭，消费线程处理完剩余槽位后退出
+int commit_shm_transfer(const std::string& transferId) {
+    std::lock_guard<std::mutex> lock(shm_sessions_mutex);
+    auto it = shm_sessions.find(transferId);
+    if (it == shm_sessions.end()) {
+        return -1;
+    }
+    
+    it->second->ring->close();
     return 0;
 }
 
 // 获取传输状态（包含位图信息）
 TransferStatus get_transfer_status(const std::string& transferId, [[maybe_unused]] const std::string& userid, [[maybe_unused]] const std::string& fileName) {
-    std::lock_guard<std::mutex> lock(transfer_states_mutex);
-    
-    auto it = file_transfer_states.find(transferId);
-    if (it != file_transfer_states.end()) {
-        return it->second;
+    std::shared_ptr<TransferState> state = find_state(transferId);
+    if (state) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->status;
     }
     
     // 如果找不到传输记录，返回默认状态
@@ -229,16 +1523,38 @@ TransferStatus get_transfer_status(const std::string& transferId, [[maybe_unused
 
 // 获取缺失的块索引列表
 std::vector<int> get_missing_chunks(const std::string& transferId, [[maybe_unused]] const std::string& userid, [[maybe_unused]] const std::string& fileName) {
-    std::lock_guard<std::mutex> lock(transfer_states_mutex);
-    
-    auto it = file_transfer_states.find(transferId);
-    if (it != file_transfer_states.end()) {
-        return it->second.getMissingChunks();
+    std::shared_ptr<TransferState> state = find_state(transferId);
+    if (state) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->status.getMissingChunks();
     }
     
     return {};
 }
 
+// 按会话句柄分页获取缺失块范围，持锁时间与本页扫描的块数成正比
+int get_missing_ranges(uint32_t handle, int cursor, size_t limit, std::vector<ChunkRange>& ranges, int& next) {
+    std::shared_ptr<TransferState> state = find_session(handle);
+    if (!state) {
+        return -1;
+    }
+    
+    std::lock_guard<std::mutex> lock(state->mutex);
+    ranges = state->status.getMissingRanges(cursor, limit, next);
+    return 0;
+}
+
+// 设置直写模式
+void set_direct_write(bool enable) {
+    direct_write_enabled = enable;
+}
+
+// 设置选择性确认回调
+void set_chunk_ack_callback(ChunkAckCallback callback) {
+    std::lock_guard<std::mutex> lock(ack_mutex);
+    chunk_ack_callback = std::move(callback);
+}
+
 // 获取线程池大小
 size_t get_receiver_thread_pool_size() {
     if (receiver_thread_pool == nullptr) {
@@ -247,15 +1563,39 @@ size_t get_receiver_thread_pool_size() {
     return receiver_thread_pool->get_thread_count();
 }
 
-// 组装并保存文件
-bool assemble_and_save_file(const std::string& transferId, const std::string& fileName, const mode_t fileMode, const std::string& outdir, const TransferStatus& status) {
-    std::lock_guard<std::mutex> lock(chunk_storage_mutex);
+// 组装并保存文件：在收尾线程上运行，只访问从传输状态中取出的数据，不持有任何锁
+bool assemble_and_save_file(FinalizeJob& job) {
+    const FileChunk& meta = *job.meta;
+    const TransferStatus& status = job.status;
+    const mode_t fileMode = meta.fileMode;
+    const std::string fileName = meta.fileName;
 
     std::cout << "[assemble_and_save_file] fileMode:" << fileMode << std::endl;
     
-    auto it = file_chunk_storage.find(transferId);
-    if (it == file_chunk_storage.end()) {
-        std::cerr << "[assemble_and_save_file] 未找到传输ID对应的文件块数据: " << transferId << std::endl;
+    // 直写模式：数据已在临时文件中，释放描述符并重命名即可（传输已标记完成，不会再有写入方）
+    if (job.output.created) {
+        const TransferOutput& done = job.output;
+        job.output.file.reset();
+        
+        if (chmod(done.tempPath.c_str(), fileMode) != 0) {
+            std::cerr << "[assemble_and_save_file] 设置文件权限失败: " << strerror(errno) << std::endl;
+        }
+        
+        if (rename(done.tempPath.c_str(), done.finalPath.c_str()) != 0) {
+            std::cerr << "[assemble_and_save_file] 重命名文件失败: " << done.tempPath << " " << strerror(errno) << std::endl;
+            return false;
+        }
+        // 重命名落盘后才删除传输日志，崩溃后不会既没有目标文件也没有日志
+        sync_parent_dir(done.finalPath);
+        
+        std::cout << "[assemble_and_save_file] 文件直写完成: " << done.finalPath 
+                  << " (" << status.fileLength << " 字节)" << std::endl;
+        return true;
+    }
+    
+    // 空文件没有块，直接创建空的目标文件
+    if (job.chunks.empty() && status.fileLength > 0) {
+        std::cerr << "[assemble_and_save_file] 未找到传输ID对应的文件块数据: " << meta.transferId << std::endl;
         return false;
     }
     
@@ -265,20 +1605,16 @@ bool assemble_and_save_file(const std::string& transferId, const std::string& fi
         return false;
     }
     
-    // 处理文件名：从完整路径中提取文件名
-    std::string actualFileName = fileName;
-    size_t lastSlash = fileName.find_last_of('/');
-    if (lastSlash != std::string::npos) {
-        actualFileName = fileName.substr(lastSlash + 1);
+    // 验证缓存的数据量
+    size_t totalWritten = job.chunks.storedBytes;
+    if (totalWritten != static_cast<size_t>(status.fileLength)) {
+        std::cerr << "[assemble_and_save_file] 文件大小不匹配: 期望=" << status.fileLength 
+                  << ", 实际=" << totalWritten << std::endl;
+        return false;
     }
     
     // 创建输出路径
-    std::string outputPath;
-    if (outdir == ".") {
-        outputPath = actualFileName; // 当前目录
-    } else {
-        outputPath = outdir + "/" + actualFileName;
-    }
+    std::string outputPath = make_output_path(fileName, job.outdir);
     
     std::cout << "[assemble_and_save_file] 保存文件路径: " << outputPath << std::endl;
     
@@ -289,25 +1625,24 @@ bool assemble_and_save_file(const std::string& transferId, const std::string& fi
         return false;
     }
     
-    // 按顺序组装文件块
-    size_t totalWritten = 0;
-    for (int i = 0; i < status.totalChunks; ++i) {
-        auto chunkIt = it->second.find(i);
-        if (chunkIt == it->second.end()) {
-            std::cerr << "[assemble_and_save_file] 缺失文件块: " << i << std::endl;
+    // 块在缓存中已按文件偏移排好，逐个slab顺序写出
+    uint64_t offset = 0;
+    while (offset < static_cast<uint64_t>(status.fileLength)) {
+        const char* data = nullptr;
+        size_t n = job.chunks.read(offset, status.fileLength - offset, &data);
+        if (n == 0) {
+            std::cerr << "[assemble_and_save_file] 缺失文件数据，偏移: " << offset << std::endl;
             outputFile.close();
             return false;
         }
         
-        const FileChunkCache& cache = chunkIt->second;
-        outputFile.write(reinterpret_cast<const char*>(cache.data.data()), cache.data.size());
-        totalWritten += cache.data.size();
-        
+        outputFile.write(data, n);
         if (!outputFile.good()) {
-            std::cerr << "[assemble_and_save_file] 写入文件块失败: " << i << std::endl;
+            std::cerr << "[assemble_and_save_file] 写入文件失败，偏移: " << offset << std::endl;
             outputFile.close();
             return false;
         }
+        offset += n;
     }
     
     outputFile.close();
@@ -318,15 +1653,8 @@ bool assemble_and_save_file(const std::string& transferId, const std::string& fi
         // 权限设置失败不影响文件组装结果，继续执行
     }
     
-    // 验证文件大小
-    if (totalWritten != static_cast<size_t>(status.fileLength)) {
-        std::cerr << "[assemble_and_save_file] 文件大小不匹配: 期望=" << status.fileLength 
-                  << ", 实际=" << totalWritten << std::endl;
-        return false;
-    }
-    
     // 清理存储的文件块数据
-    file_chunk_storage.erase(it);
+    job.chunks.clear();
     
     std::cout << "[assemble_and_save_file] 文件组装完成: " << fileName 
               << " (" << totalWritten << " 字节)" << std::endl;
@@ -3,6 +3,7 @@
 #include <thread>
 #include <chrono>
 #include <vector>
+#include <algorithm>
 #include "DBusAdapter.h"
 #include "TestService.h"
 #include "SafeData.h"
@@ -16,16 +17,19 @@ TestService* g_test_service = nullptr;
 void signalHandler(int sig) {
     if (sig == SIGINT) {
         std::cout << "\n[Server] 接收到退出信号，正在清理资源..." << std::endl;
+        // 确认线程会经TestService和DBusAdapter推送信号，先停止；
+        // 再销毁DBusAdapter，分派线程和工作线程池退出后不再有调用进入接收器
+        stop_chunk_acks();
         if (g_dbus_adapter) {
             delete g_dbus_adapter;
             g_dbus_adapter = nullptr;
         }
+        cleanup_file_receiver();
+        std::cout << "[Server] FileReceiver资源已清理" << std::endl;
         if (g_test_service) {
             delete g_test_service;
             g_test_service = nullptr;
         }
-        cleanup_file_receiver();
-        std::cout << "[Server] FileReceiver资源已清理" << std::endl;
         std::cout << "[Server] 资源清理完成，退出成功" << std::endl;
         exit(0);
     }
@@ -108,7 +112,14 @@ int main() {
 
     // 5. 初始化DBus适配器
     g_dbus_adapter = new DBusAdapter(g_test_service);
-    if (!g_dbus_adapter || !g_dbus_adapter->init()) {
+    if (!g_dbus_adapter) {
+        std::cerr << "[Server] DBus适配器创建失败！" << std::endl;
+        delete g_test_service;
+        return -1;
+    }
+    // 方法解码与分派分散到多个线程，每个线程独占一个GMainContext，线程数取CPU核数（无法获取时为1）
+    g_dbus_adapter->setDispatchThreads(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+    if (!g_dbus_adapter->init()) {
         std::cerr << "[Server] DBus适配器初始化失败！" << std::endl;
         delete g_test_service;
         return -1;
@@ -125,9 +136,13 @@ int main() {
     // 7. 启动DBus事件循环
     g_dbus_adapter->runLoop();
 
-    // 8. 释放资源
+    // 8. 释放资源：顺序同信号处理
+    stop_chunk_acks();
     delete g_dbus_adapter;
+    g_dbus_adapter = nullptr;
+    cleanup_file_receiver();
     delete g_test_service;
+    g_test_service = nullptr;
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+// 块位图基准：在1M和100M块上对比原来的std::vector<bool>与ChunkBitmap的常用操作：
+// 逐块置位、计数、完成检查、遍历缺失块（每1000块缺1块）以及查询时的快照拷贝。
+// ChunkBitmap置位要维护计数和摘要，比vector<bool>慢，换来O(1)的计数和完成检查以及按摘要跳跃的扫描
+#include "FileTransfer.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+static volatile size_t sink = 0;
+
+// 运行fn并返回耗时（毫秒）
+template <typename Fn>
+static double time_ms(Fn fn) {
+    auto start = BenchClock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+static void report(const char* op, double legacy_ms, double bitmap_ms) {
+    std::printf("  %-16s %12.3f ms %12.3f ms %10.1fx\n", op, legacy_ms, bitmap_ms, legacy_ms / bitmap_ms);
+}
+
+static void run(int n) {
+    const int gap = 1000;
+    std::printf("%d 块:\n  %-16s %15s %15s %11s\n", n, "操作", "vector<bool>", "ChunkBitmap", "加速比");
+    
+    std::vector<bool> legacy(n, false);
+    ChunkBitmap bitmap(n);
+    
+    // 逐块置位，每gap块留一个缺口
+    double legacy_set = time_ms([&]() {
+        for (int i = 0; i < n; ++i) {
+            if (i % gap != 0) {
+                legacy[i] = true;
+            }
+        }
+    });
+    double bitmap_set = time_ms([&]() {
+        for (int i = 0; i < n; ++i) {
+            if (i % gap != 0) {
+                bitmap.set(i);
+            }
+        }
+    });
+    report("置位", legacy_set, bitmap_set);
+    
+    double legacy_count = time_ms([&]() {
+        size_t count = 0;
+        for (bool bit : legacy) {
+            count += bit;
+        }
+        sink = count;
+    });
+    double bitmap_count = time_ms([&]() { sink = bitmap.count(); });
+    report("计数", legacy_count, bitmap_count);
+    
+    // 原实现判断完成需要扫描到第一个缺口，这里取最坏情况：只缺最后一块
+    std::vector<bool> legacy_last(n, true);
+    legacy_last[n - 1] = false;
+    ChunkBitmap last_missing(n);
+    last_missing.setRange(0, n - 1);
+    double legacy_all = time_ms([&]() {
+        bool all = true;
+        for (bool bit : legacy_last) {
+            if (!bit) {
+                all = false;
+                break;
+            }
+        }
+        sink = all;
+    });
+    double bitmap_all = time_ms([&]() { sink = last_missing.all(); });
+    report("完成检查", legacy_all, bitmap_all);
+    
+    double legacy_missing = time_ms([&]() {
+        std::vector<int> missing;
+        for (int i = 0; i < n; ++i) {
+            if (!legacy[i]) {
+                missing.push_back(i);
+            }
+        }
+        sink = missing.size();
+    });
+    double bitmap_missing = time_ms([&]() {
+        std::vector<int> missing;
+        for (int i = bitmap.findNextMissing(0); i < n; i = bitmap.findNextMissing(i + 1)) {
+            missing.push_back(i);
+        }
+        sink = missing.size();
+    });
+    report("遍历缺失块", legacy_missing, bitmap_missing);
+    
+    // 查询传输状态时复制位图：原实现整份拷贝，ChunkBitmap共享存储直到下一次写入
+    double legacy_copy = time_ms([&]() {
+        std::vector<bool> copy = legacy;
+        sink = copy.size();
+    });
+    double bitmap_copy = time_ms([&]() {
+        ChunkBitmap copy = bitmap;
+        sink = copy.size();
+    });
+    report("快照拷贝", legacy_copy, bitmap_copy);
+}
+
+int main() {
+    run(1000000);
+    run(100000000);
+    return 0;
+}
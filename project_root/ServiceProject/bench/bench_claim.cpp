@@ -0,0 +1,190 @@
+// 传输表争用基准：64个并发传输。
+// 第一部分只测块标记：原来的全局互斥锁 + std::map + vector<bool>（每块加锁三次：查找、标记、检查完成）
+// 对比分片传输表 + 原子认领位（每块一次分片查找和一次fetch_or），两者都由64个线程交错处理所有传输的块。
+// 第二部分经receive_session_chunks端到端接收64个直写传输，统计吞吐并确认每个传输恰好完成一次。
+#include "../Sources/filetransfer/FileReceiver.cpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using BenchClock = std::chrono::steady_clock;
+
+static const int TRANSFERS = 64;
+static const int THREADS = 64;
+static const int CLAIM_CHUNKS = 1 << 16;         // 标记测试中每个传输的块数
+static const uint32_t E2E_CHUNK_SIZE = 64 * 1024;
+static const int E2E_CHUNKS = 64;                // 端到端测试中每个传输的块数（4MB）
+static const int E2E_BATCH = 8;
+
+static std::string transfer_id(const char* prefix, int t) {
+    return std::string(prefix) + std::to_string(t);
+}
+
+// 线程t按步长THREADS处理每个传输的块，起始传输错开，所有线程都会碰到所有传输
+template <typename Fn>
+static double run_threads(Fn fn) {
+    auto start = BenchClock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([t, &fn]() {
+            for (int k = 0; k < TRANSFERS; ++k) {
+                int transfer = (t + k) % TRANSFERS;
+                for (int index = t; index < CLAIM_CHUNKS; index += THREADS) {
+                    fn(transfer, index);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+// 原实现的形态：一把全局锁保护所有传输的状态
+struct LegacyState {
+    std::vector<bool> bitmap;
+    int received = 0;
+    bool completed = false;
+};
+
+static void bench_legacy() {
+    std::mutex mutex;
+    std::map<std::string, LegacyState> states;
+    std::vector<std::string> ids;
+    for (int t = 0; t < TRANSFERS; ++t) {
+        ids.push_back(transfer_id("legacy-", t));
+        states[ids.back()].bitmap.assign(CLAIM_CHUNKS, false);
+    }
+    std::atomic<int> completions{0};
+    
+    double seconds = run_threads([&](int transfer, int index) {
+        const std::string& id = ids[transfer];
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (states.find(id) == states.end()) {
+                return;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            LegacyState& state = states[id];
+            if (!state.bitmap[index]) {
+                state.bitmap[index] = true;
+                state.received++;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        LegacyState& state = states[id];
+        if (state.received == CLAIM_CHUNKS && !state.completed) {
+            state.completed = true;
+            ++completions;
+        }
+    });
+    double chunks = static_cast<double>(TRANSFERS) * CLAIM_CHUNKS;
+    std::printf("  全局锁 + map:        %8.1f ns/块  %7.2f M块/s  完成次数 %d/%d\n",
+                seconds * 1e9 / chunks, chunks / seconds / 1e6, completions.load(), TRANSFERS);
+}
+
+static void bench_sharded() {
+    std::vector<std::string> ids;
+    for (int t = 0; t < TRANSFERS; ++t) {
+        ids.push_back(transfer_id("sharded-", t));
+        FileChunk meta("bench", 0, CLAIM_CHUNKS, "claim.bin", static_cast<uint64_t>(CLAIM_CHUNKS) * FILE_CHUNK_SIZE,
+                       ids.back());
+        find_or_create_state(meta, ".");
+    }
+    std::atomic<int> completions{0};
+    
+    double seconds = run_threads([&](int transfer, int index) {
+        std::shared_ptr<TransferState> state = find_state(ids[transfer]);
+        if (!state || !claim_chunk(*state, index) || state->remaining.load(std::memory_order_acquire) != 0) {
+            return;
+        }
+        // 与finish_transfer_if_complete相同，在状态锁下用finished保证只完成一次
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->finished) {
+            state->finished = true;
+            ++completions;
+        }
+    });
+    double chunks = static_cast<double>(TRANSFERS) * CLAIM_CHUNKS;
+    std::printf("  分片表 + 原子认领位: %8.1f ns/块  %7.2f M块/s  完成次数 %d/%d\n",
+                seconds * 1e9 / chunks, chunks / seconds / 1e6, completions.load(), TRANSFERS);
+    
+    for (const std::string& id : ids) {
+        TransferShard& shard = transfer_shard(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.states.erase(id);
+    }
+}
+
+// 端到端：每个传输一个发送线程，按会话批次发送全部块，等待全部传输收尾
+static void bench_end_to_end() {
+    std::vector<char> payload(static_cast<size_t>(E2E_CHUNKS) * E2E_CHUNK_SIZE, 'c');
+    std::vector<TransferSession> sessions(TRANSFERS);
+    for (int t = 0; t < TRANSFERS; ++t) {
+        FileChunk meta("bench", 0, 0, "claim_" + std::to_string(t) + ".bin", payload.size(), transfer_id("e2e-", t));
+        sessions[t] = open_transfer(meta, E2E_CHUNK_SIZE, ".");
+    }
+    
+    auto start = BenchClock::now();
+    std::vector<std::thread> senders;
+    for (int t = 0; t < TRANSFERS; ++t) {
+        senders.emplace_back([&, t]() {
+            for (int first = 0; first < E2E_CHUNKS; first += E2E_BATCH) {
+                std::vector<ChunkView> views;
+                for (int i = first; i < std::min(first + E2E_BATCH, E2E_CHUNKS); ++i) {
+                    ChunkView view;
+                    view.fileIndex = i;
+                    view.data = payload.data() + static_cast<size_t>(i) * E2E_CHUNK_SIZE;
+                    view.length = E2E_CHUNK_SIZE;
+                    views.push_back(view);
+                }
+                // 内存预算满时稍后重试
+                while (receive_session_chunks(sessions[t].handle, views) != 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        });
+    }
+    for (auto& sender : senders) {
+        sender.join();
+    }
+    
+    // 收尾完成后传输从表中移除
+    int pending = TRANSFERS;
+    while (pending > 0 && BenchClock::now() - start < std::chrono::seconds(120)) {
+        pending = 0;
+        for (int t = 0; t < TRANSFERS; ++t) {
+            pending += find_state(transfer_id("e2e-", t)) != nullptr;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double seconds = std::chrono::duration<double>(BenchClock::now() - start).count();
+    double megabytes = static_cast<double>(TRANSFERS) * payload.size() / (1024.0 * 1024.0);
+    std::printf("  %d个传输共 %.0f MB 用时 %.2f s，%.1f MB/s，未完成 %d\n", TRANSFERS, megabytes, seconds,
+                megabytes / seconds, pending);
+}
+
+int main() {
+    char dir[] = "/tmp/claim_bench_XXXXXX";
+    if (mkdtemp(dir) == nullptr || chdir(dir) != 0) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    
+    std::printf("块标记（%d个传输 x %d块，%d线程）:\n", TRANSFERS, CLAIM_CHUNKS, THREADS);
+    bench_legacy();
+    bench_sharded();
+    
+    if (init_file_receiver(std::thread::hardware_concurrency()) != 0) {
+        return 1;
+    }
+    std::printf("端到端直写（每个传输 %d x %u KB）:\n", E2E_CHUNKS, E2E_CHUNK_SIZE / 1024);
+    bench_end_to_end();
+    cleanup_file_receiver();
+    
+    std::string cleanup = std::string("rm -rf ") + dir;
+    return std::system(cleanup.c_str()) == 0 ? 0 : 1;
+}
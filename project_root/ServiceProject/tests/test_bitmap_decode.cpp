@@ -0,0 +1,90 @@
+// 位图解码测试：decodeBitmap解析的是客户端收到的服务端数据，编码结果必须能原样解回；
+// 截断、编码未知、变长整数过长或游程覆盖不满总块数的输入都要拒绝，越过总块数的位不能被置位
+#include "FileTransfer.h"
+#include "test_util.h"
+#include <random>
+
+// 按encoding编码src后解码到一个同样长度的状态，返回是否与原位图一致
+static bool round_trip(const TransferStatus& src) {
+    uint8_t encoding = 0;
+    std::vector<uint8_t> data = src.encodeBitmap(encoding);
+    TransferStatus dst(src.totalChunks, 0);
+    if (!dst.decodeBitmap(encoding, data.data(), data.size())) {
+        return false;
+    }
+    for (int i = 0; i < src.totalChunks; ++i) {
+        if (dst.chunkBitmap.test(i) != src.chunkBitmap.test(i)) {
+            return false;
+        }
+    }
+    return dst.chunkBitmap.count() == src.chunkBitmap.count();
+}
+
+static bool decode(int total, uint8_t encoding, const std::vector<uint8_t>& data, TransferStatus* out = nullptr) {
+    TransferStatus status(total, 0);
+    bool ok = status.decodeBitmap(encoding, data.data(), data.size());
+    if (out) {
+        *out = status;
+    }
+    return ok;
+}
+
+int main() {
+    // 各种长度和密度的往返：稀疏的走游程编码，随机的走紧凑位图
+    std::mt19937 rng(12345);
+    for (int total : {0, 1, 63, 64, 65, 1000, 4097}) {
+        for (int density : {0, 1, 50, 99, 100}) {
+            TransferStatus status(total, 0);
+            for (int i = 0; i < total; ++i) {
+                if (static_cast<int>(rng() % 100) < density) {
+                    status.markChunkReceived(i, 1);
+                }
+            }
+            EXPECT(round_trip(status));
+        }
+    }
+    TransferStatus sparse(100000, 0);
+    sparse.chunkBitmap.setRange(10, 5000);
+    sparse.chunkBitmap.setRange(99999, 1);
+    uint8_t encoding = 0;
+    EXPECT(sparse.encodeBitmap(encoding).size() < 16 && encoding == BITMAP_ENCODING_RLE);
+    EXPECT(round_trip(sparse));
+    
+    // 紧凑位图：字节数不足时拒绝，超出总块数的位被清除
+    EXPECT(!decode(17, BITMAP_ENCODING_PACKED, {0xFF, 0xFF}));
+    TransferStatus packed;
+    EXPECT(decode(10, BITMAP_ENCODING_PACKED, {0xFF, 0xFF, 0xFF}, &packed));
+    EXPECT(packed.chunkBitmap.count() == 10 && packed.chunkBitmap.all());
+    
+    // 未知编码
+    EXPECT(!decode(8, 7, {0x08}));
+    
+    // 游程：未置位4块、置位4块正好覆盖
+    TransferStatus rle;
+    EXPECT(decode(8, BITMAP_ENCODING_RLE, {0x04, 0x04}, &rle));
+    EXPECT(rle.chunkBitmap.count() == 4 && !rle.chunkBitmap.test(3) && rle.chunkBitmap.test(4));
+    
+    // 游程覆盖不满总块数、数据为空、变长整数在末尾被截断
+    EXPECT(!decode(8, BITMAP_ENCODING_RLE, {0x04, 0x03}));
+    EXPECT(!decode(8, BITMAP_ENCODING_RLE, {}));
+    EXPECT(!decode(200, BITMAP_ENCODING_RLE, {0x80}));
+    
+    // 变长整数超过64位（10个续位字节）
+    EXPECT(!decode(8, BITMAP_ENCODING_RLE, std::vector<uint8_t>(10, 0xFF)));
+    
+    // 超长游程截断到总块数，不越界置位；多余的尾部数据忽略
+    TransferStatus clamp;
+    EXPECT(decode(70, BITMAP_ENCODING_RLE, {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x05}, &clamp));
+    EXPECT(clamp.chunkBitmap.count() == 70 && clamp.chunkBitmap.all());
+    
+    // 长度为0的游程只切换状态
+    TransferStatus zero_runs;
+    EXPECT(decode(3, BITMAP_ENCODING_RLE, {0x00, 0x00, 0x00, 0x03}, &zero_runs));
+    EXPECT(zero_runs.chunkBitmap.count() == 3);
+    
+    // 空传输：两种编码的空数据都有效
+    EXPECT(decode(0, BITMAP_ENCODING_RLE, {}));
+    EXPECT(decode(0, BITMAP_ENCODING_PACKED, {}));
+    
+    return test_result("test_bitmap_decode");
+}
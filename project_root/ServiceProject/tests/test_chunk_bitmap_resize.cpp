@@ -0,0 +1,36 @@
+// 块位图缩放测试：缩小时新长度之外的位必须清除，不能计入计数，也不能在再次放大后重新出现
+#include "FileTransfer.h"
+#include "test_util.h"
+
+int main() {
+    // 缩小到字中间：尾字的高位被截掉
+    ChunkBitmap full(128);
+    full.setRange(0, 128);
+    full.resize(70);
+    EXPECT(full.count() == 70);
+    EXPECT(full.all());
+    full.resize(128);
+    EXPECT(full.count() == 70);
+    EXPECT(full.findNextMissing(0) == 70);
+    EXPECT(!full.test(127));
+
+    // 只有被截掉的位置位：缩小后为空
+    ChunkBitmap tail(100);
+    tail.set(99);
+    tail.resize(99);
+    EXPECT(tail.none());
+    EXPECT(tail.findNextSet(0) == 99);
+    tail.resize(100);
+    EXPECT(!tail.test(99));
+
+    // 缩小到字边界：整字丢弃，计数只保留前面的位
+    ChunkBitmap boundary(130);
+    boundary.setRange(60, 70);
+    boundary.resize(64);
+    EXPECT(boundary.count() == 4);
+    int next = 0;
+    std::vector<ChunkRange> missing = boundary.missingRanges(0, 8, next);
+    EXPECT(missing.size() == 1 && missing[0].first == 0 && missing[0].count == 60);
+
+    return test_result("test_chunk_bitmap_resize");
+}
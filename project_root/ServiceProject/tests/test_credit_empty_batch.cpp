@@ -0,0 +1,46 @@
+// 空批次的额度计数测试：空批次不能改变活跃传输数，也不能把它减到0以下
+#include "../Sources/filetransfer/FileReceiver.cpp"
+#include "test_util.h"
+
+int main() {
+    if (!enter_temp_dir("credit_test") || init_file_receiver(1) != 0) {
+        return 1;
+    }
+    
+    FileChunk meta("user", 0, 0, "empty_batch.bin", 4 * FILE_CHUNK_SIZE, "credit-empty-batch");
+    TransferSession session = open_transfer(meta, 0, ".");
+    EXPECT(session.handle != 0);
+    std::shared_ptr<TransferState> state = find_session(session.handle);
+    EXPECT(state != nullptr);
+    if (!state) {
+        cleanup_file_receiver();
+        return 1;
+    }
+    
+    // 通过公开接口发送空批次：成功返回，额度不为0，不计入活跃传输
+    uint32_t credit = 0;
+    EXPECT(receive_session_chunks(session.handle, {}, &credit) == 0);
+    EXPECT(credit > 0);
+    EXPECT(active_transfers.load() == 0);
+    EXPECT(state->queuedBytes.load() == 0);
+    
+    // 有积压时插入空批次，积压先于空批次释放：原来空批次的释放会把活跃传输数减到0以下
+    EXPECT(reserve_transfer_bytes(*state, FILE_CHUNK_SIZE));
+    EXPECT(reserve_transfer_bytes(*state, 0));
+    EXPECT(active_transfers.load() == 1);
+    release_transfer_bytes(*state, FILE_CHUNK_SIZE);
+    release_transfer_bytes(*state, 0);
+    EXPECT(active_transfers.load() == 0);
+    EXPECT(current_memory_usage.load() == 0);
+    
+    // 计数正确时，有积压的传输仍能拿到非0额度
+    EXPECT(reserve_transfer_bytes(*state, FILE_CHUNK_SIZE));
+    EXPECT(grant_credit(*state) > 0);
+    release_transfer_bytes(*state, FILE_CHUNK_SIZE);
+    EXPECT(active_transfers.load() == 0);
+    
+    close_transfer(session.handle);
+    cleanup_file_receiver();
+    
+    return test_result("test_credit_empty_batch");
+}
@@ -0,0 +1,35 @@
+// 空文件传输测试：长度为0的文件没有块可收，打开传输时就要完成，创建空的目标文件并释放状态和会话
+#include "../Sources/filetransfer/FileReceiver.cpp"
+#include "test_util.h"
+
+// 等待传输收尾完成（从传输表中移除）
+static bool wait_finalized(const std::string& transferId) {
+    for (int i = 0; i < 5000 && find_state(transferId); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return find_state(transferId) == nullptr;
+}
+
+int main() {
+    if (!enter_temp_dir("empty_file_test") || init_file_receiver(1) != 0) {
+        return 1;
+    }
+    
+    FileChunk meta("user", 0, 0, "empty.bin", 0, "empty-file", 0640);
+    TransferSession session = open_transfer(meta, 0, ".");
+    EXPECT(session.handle != 0 && session.totalChunks == 0);
+    EXPECT(wait_finalized("empty-file"));
+    EXPECT(find_session(session.handle) == nullptr);
+    
+    struct stat st;
+    EXPECT(stat("empty.bin", &st) == 0 && st.st_size == 0 && (st.st_mode & 0777) == 0640);
+    
+    // 已存在的同名文件被空文件替换
+    EXPECT(truncate("empty.bin", 100) == 0);
+    open_transfer(meta, 0, ".");
+    EXPECT(wait_finalized("empty-file"));
+    EXPECT(stat("empty.bin", &st) == 0 && st.st_size == 0);
+    cleanup_file_receiver();
+    
+    return test_result("test_empty_file");
+}
@@ -0,0 +1,77 @@
+// 收尾失败测试：重命名失败时日志、临时文件、传输状态和会话都要保留，状态码为错误；
+// 排除故障后重新打开传输会再次收尾，保存成功后才删除日志
+#include "../Sources/filetransfer/FileReceiver.cpp"
+#include "test_util.h"
+#include <fstream>
+#include <iterator>
+
+static const char* TRANSFER_ID = "finalize-retry";
+static const int TOTAL_CHUNKS = 3;
+static const uint32_t CHUNK_SIZE = MIN_CHUNK_SIZE;
+
+// 等待cond成立，最多约5秒
+template <typename Cond>
+static bool wait_for(Cond cond) {
+    for (int i = 0; i < 5000 && !cond(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return cond();
+}
+
+int main() {
+    if (!enter_temp_dir("finalize_retry_test") || init_file_receiver(2) != 0) {
+        return 1;
+    }
+    
+    // 目标路径被一个非空目录占着，重命名会失败
+    EXPECT(mkdir("retry.bin", 0700) == 0 && mkdir("retry.bin/blocker", 0700) == 0);
+    
+    FileChunk meta("user", 0, 0, "retry.bin", TOTAL_CHUNKS * CHUNK_SIZE, TRANSFER_ID);
+    TransferSession session = open_transfer(meta, CHUNK_SIZE, ".");
+    EXPECT(session.handle != 0);
+    auto payload = std::make_shared<std::vector<char>>(CHUNK_SIZE, 'r');
+    std::vector<ChunkView> views(TOTAL_CHUNKS);
+    for (int i = 0; i < TOTAL_CHUNKS; ++i) {
+        views[i].owner = payload;
+        views[i].fileIndex = i;
+        views[i].data = payload->data();
+        views[i].length = payload->size();
+    }
+    EXPECT(receive_session_chunks(session.handle, views) == 0);
+    
+    std::shared_ptr<TransferState> state = find_state(TRANSFER_ID);
+    EXPECT(state != nullptr);
+    if (!state) {
+        return test_result("test_finalize_retry");
+    }
+    EXPECT(wait_for([&]() {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->status.statusCode == 2 && !state->finished;
+    }));
+    std::string journal;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        EXPECT(state->journal != nullptr && state->output.created);
+        journal = state->journal ? state->journal->path : "";
+    }
+    EXPECT(!journal.empty() && access(journal.c_str(), F_OK) == 0);
+    EXPECT(access(make_temp_path("retry.bin", TRANSFER_ID).c_str(), F_OK) == 0);
+    EXPECT(find_state(TRANSFER_ID) == state);
+    EXPECT(find_session(session.handle) == state);
+    
+    // 排除故障后重新打开：沿用原句柄，再次收尾成功后传输、日志和临时文件都清理掉
+    EXPECT(rmdir("retry.bin/blocker") == 0 && rmdir("retry.bin") == 0);
+    TransferSession reopened = open_transfer(meta, CHUNK_SIZE, ".");
+    EXPECT(reopened.handle == session.handle);
+    EXPECT(wait_for([]() { return find_state(TRANSFER_ID) == nullptr; }));
+    EXPECT(find_session(session.handle) == nullptr);
+    EXPECT(access(journal.c_str(), F_OK) != 0);
+    EXPECT(access(make_temp_path("retry.bin", TRANSFER_ID).c_str(), F_OK) != 0);
+    std::ifstream in("retry.bin", std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT(content == std::string(TOTAL_CHUNKS * CHUNK_SIZE, 'r'));
+    
+    state.reset();
+    cleanup_file_receiver();
+    return test_result("test_finalize_retry");
+}
@@ -0,0 +1,90 @@
+// 传输日志测试：文件名哈希被其他传输占用时不覆盖对方的日志，重启后按完整传输ID恢复，
+// 过期的日志连同临时文件一起删除
+#include "../Sources/filetransfer/FileReceiver.cpp"
+#include "test_util.h"
+#include <sys/time.h>
+
+static const char* TRANSFER_ID = "journal-recovery";
+static const int TOTAL_CHUNKS = 4;
+static const uint32_t CHUNK_SIZE = MIN_CHUNK_SIZE;
+
+// 模拟服务端重启：清空内存中的传输状态，只留下磁盘上的日志和临时文件
+static void forget_transfers() {
+    for (TransferShard& shard : transfer_shards) {
+        shard.states.clear();
+    }
+    session_slots.clear();
+    free_session_slots.clear();
+}
+
+// 在path处放一份属于other_id的日志（只有文件头）
+static void plant_foreign_journal(const std::string& path, const char* other_id) {
+    JournalHeader header{};
+    header.magic = JOURNAL_MAGIC;
+    header.version = JOURNAL_VERSION;
+    strncpy(header.transferId, other_id, sizeof(header.transferId) - 1);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    EXPECT(fd >= 0 && write(fd, &header, sizeof(header)) == static_cast<ssize_t>(sizeof(header)));
+    close(fd);
+}
+
+static std::string journal_owner(const std::string& path) {
+    std::string owner;
+    return read_journal_owner(path, owner) ? owner : "<missing>";
+}
+
+int main() {
+    if (!enter_temp_dir("journal_test") || init_file_receiver(2) != 0) {
+        return 1;
+    }
+    
+    // 首选文件名已被另一个传输占用
+    const std::string taken = journal_path(TRANSFER_ID, 0);
+    plant_foreign_journal(taken, "someone-else");
+    
+    FileChunk meta("user", 0, 0, "journal.bin", TOTAL_CHUNKS * CHUNK_SIZE, TRANSFER_ID);
+    TransferSession session = open_transfer(meta, CHUNK_SIZE, ".");
+    EXPECT(session.handle != 0 && session.chunkSize == CHUNK_SIZE && session.totalChunks == TOTAL_CHUNKS);
+    std::vector<char> payload(CHUNK_SIZE, 'j');
+    std::vector<ChunkView> views(2);
+    for (int i = 0; i < 2; ++i) {
+        views[i].fileIndex = i;
+        views[i].data = payload.data();
+        views[i].length = payload.size();
+    }
+    EXPECT(receive_session_chunks(session.handle, views) == 0);
+    cleanup_file_receiver();
+    
+    EXPECT(journal_owner(taken) == "someone-else");
+    EXPECT(journal_owner(journal_path(TRANSFER_ID, 1)) == TRANSFER_ID);
+    
+    // 重启恢复：占位日志的文件名与头中的ID不符被丢弃，本传输从备用名恢复出已提交的两块
+    forget_transfers();
+    EXPECT(init_file_receiver(2) == 0);
+    EXPECT(journal_owner(taken) == "<missing>");
+    std::shared_ptr<TransferState> state = find_state(TRANSFER_ID);
+    EXPECT(state != nullptr);
+    if (state) {
+        EXPECT(state->status.receivedChunks == 2);
+        EXPECT(state->remaining.load() == TOTAL_CHUNKS - 2);
+    }
+    state.reset();
+    cleanup_file_receiver();
+    
+    // 超过保留期未更新的日志在恢复时连同临时文件删除
+    forget_transfers();
+    const std::string journal = journal_path(TRANSFER_ID, 1);
+    struct timeval old_times[2];
+    gettimeofday(&old_times[0], nullptr);
+    old_times[0].tv_sec -= JOURNAL_EXPIRE_SECONDS + 60;
+    old_times[1] = old_times[0];
+    EXPECT(access(make_temp_path("journal.bin", TRANSFER_ID).c_str(), F_OK) == 0);
+    EXPECT(utimes(journal.c_str(), old_times) == 0);
+    EXPECT(init_file_receiver(2) == 0);
+    EXPECT(find_state(TRANSFER_ID) == nullptr);
+    EXPECT(access(journal.c_str(), F_OK) != 0);
+    EXPECT(access(make_temp_path("journal.bin", TRANSFER_ID).c_str(), F_OK) != 0);
+    cleanup_file_receiver();
+    
+    return test_result("test_journal_recovery");
+}
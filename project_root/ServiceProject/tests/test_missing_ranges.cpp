@@ -0,0 +1,102 @@
+// 缺失范围分页测试：按next逐页取出的范围拼起来必须与逐块扫描的结果一致，
+// 中途翻页不能漏掉或重复块，末页的next为0；会话句柄无效时返回错误
+#include "../Sources/filetransfer/FileReceiver.cpp"
+#include "test_util.h"
+#include <random>
+
+// 逐块扫描得到的缺失范围，作为对照
+static std::vector<ChunkRange> scan_missing(const TransferStatus& status, int cursor) {
+    std::vector<ChunkRange> ranges;
+    for (int i = std::max(cursor, 0); i < status.totalChunks; ++i) {
+        if (status.chunkBitmap.test(i)) {
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == i) {
+            ranges.back().count++;
+        } else {
+            ranges.push_back({i, 1});
+        }
+    }
+    return ranges;
+}
+
+// 从cursor开始按limit翻页直到next为0，返回全部范围；页数超过pages_limit视为没有收敛
+static std::vector<ChunkRange> page_all(const TransferStatus& status, int cursor, size_t limit, int pages_limit) {
+    std::vector<ChunkRange> all;
+    int pages = 0;
+    do {
+        int next = 0;
+        std::vector<ChunkRange> page = status.getMissingRanges(cursor, limit, next);
+        EXPECT(page.size() <= limit);
+        EXPECT(next == 0 || next > cursor);
+        all.insert(all.end(), page.begin(), page.end());
+        cursor = next;
+    } while (cursor != 0 && ++pages < pages_limit);
+    EXPECT(cursor == 0);
+    return all;
+}
+
+static bool same_ranges(const std::vector<ChunkRange>& a, const std::vector<ChunkRange>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].first != b[i].first || a[i].count != b[i].count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    // 全部缺失和全部收到
+    TransferStatus empty(1000, 0);
+    int next = -1;
+    std::vector<ChunkRange> ranges = empty.getMissingRanges(0, 4, next);
+    EXPECT(ranges.size() == 1 && ranges[0].first == 0 && ranges[0].count == 1000 && next == 0);
+    TransferStatus full(1000, 0);
+    full.chunkBitmap.setRange(0, 1000);
+    EXPECT(full.getMissingRanges(0, 4, next).empty() && next == 0);
+    
+    // 随机缺口，各种页大小逐页翻完与逐块扫描一致；最后一块缺失时范围落在尾字
+    std::mt19937 rng(2024);
+    for (int total : {1, 64, 130, 5000}) {
+        TransferStatus status(total, 0);
+        for (int i = 0; i < total; ++i) {
+            if (i != total - 1 && rng() % 3 != 0) {
+                status.markChunkReceived(i, 1);
+            }
+        }
+        std::vector<ChunkRange> expected = scan_missing(status, 0);
+        for (size_t limit : {1, 2, 7, 1000}) {
+            EXPECT(same_ranges(page_all(status, 0, limit, total + 1), expected));
+        }
+    }
+    
+    // cursor落在缺失范围中间：该范围从cursor开始；cursor越界时为空
+    TransferStatus gaps(100, 0);
+    gaps.chunkBitmap.setRange(0, 10);
+    gaps.chunkBitmap.setRange(30, 40);
+    ranges = gaps.getMissingRanges(15, 1, next);
+    EXPECT(ranges.size() == 1 && ranges[0].first == 15 && ranges[0].count == 15 && next == 70);
+    ranges = gaps.getMissingRanges(next, 1, next);
+    EXPECT(ranges.size() == 1 && ranges[0].first == 70 && ranges[0].count == 30 && next == 0);
+    EXPECT(gaps.getMissingRanges(100, 8, next).empty() && next == 0);
+    EXPECT(same_ranges(gaps.getMissingRanges(-5, 8, next), scan_missing(gaps, 0)));
+    
+    // 经会话句柄分页
+    if (!enter_temp_dir("missing_ranges_test") || init_file_receiver(1) != 0) {
+        return 1;
+    }
+    FileChunk meta("user", 0, 0, "missing.bin", 8 * static_cast<uint64_t>(MIN_CHUNK_SIZE), "missing-ranges");
+    TransferSession session = open_transfer(meta, MIN_CHUNK_SIZE, ".");
+    EXPECT(session.handle != 0 && session.totalChunks == 8);
+    EXPECT(get_missing_ranges(session.handle, 0, 4, ranges, next) == 0);
+    EXPECT(ranges.size() == 1 && ranges[0].first == 0 && ranges[0].count == 8 && next == 0);
+    EXPECT(get_missing_ranges(session.handle + 1, 0, 4, ranges, next) != 0);
+    close_transfer(session.handle);
+    EXPECT(get_missing_ranges(session.handle, 0, 4, ranges, next) != 0);
+    cleanup_file_receiver();
+    
+    return test_result("test_missing_ranges");
+}
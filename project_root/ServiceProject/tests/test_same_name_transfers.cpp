@@ -0,0 +1,66 @@
+// 同名文件并发传输测试：两个传输的目标文件名相同时各自写入自己的临时文件，
+// 先完成的传输保存后不会被另一个传输的写入覆盖，后完成的传输也能正常重命名
+#include "../Sources/filetransfer/FileReceiver.cpp"
+#include "test_util.h"
+#include <fstream>
+#include <iterator>
+
+static const int TOTAL_CHUNKS = 4;
+static const uint32_t CHUNK_SIZE = MIN_CHUNK_SIZE;
+
+// 发送[first, first + count)块，内容全部为fill；负载由视图持有，批次在线程池中处理完才释放
+static void send_chunks(uint32_t handle, int first, int count, char fill) {
+    auto payload = std::make_shared<std::vector<char>>(CHUNK_SIZE, fill);
+    std::vector<ChunkView> views(count);
+    for (int i = 0; i < count; ++i) {
+        views[i].owner = payload;
+        views[i].fileIndex = first + i;
+        views[i].data = payload->data();
+        views[i].length = payload->size();
+    }
+    EXPECT(receive_session_chunks(handle, views) == 0);
+}
+
+// 等待传输收尾完成（从传输表中移除）
+static bool wait_finalized(const std::string& transferId) {
+    for (int i = 0; i < 5000 && find_state(transferId); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return find_state(transferId) == nullptr;
+}
+
+// 文件内容是否为TOTAL_CHUNKS个块、全部为fill
+static bool file_filled_with(const std::string& path, char fill) {
+    std::ifstream in(path, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return content.size() == TOTAL_CHUNKS * CHUNK_SIZE && content.find_first_not_of(fill) == std::string::npos;
+}
+
+int main() {
+    if (!enter_temp_dir("same_name_test") || init_file_receiver(2) != 0) {
+        return 1;
+    }
+    
+    FileChunk first_meta("user", 0, 0, "same.bin", TOTAL_CHUNKS * CHUNK_SIZE, "same-name-a");
+    FileChunk second_meta("user", 0, 0, "same.bin", TOTAL_CHUNKS * CHUNK_SIZE, "same-name-b");
+    TransferSession first = open_transfer(first_meta, CHUNK_SIZE, ".");
+    TransferSession second = open_transfer(second_meta, CHUNK_SIZE, ".");
+    EXPECT(first.handle != 0 && second.handle != 0 && first.handle != second.handle);
+    
+    // 两个传输交错写入同样的块
+    send_chunks(first.handle, 0, 2, 'a');
+    send_chunks(second.handle, 0, 3, 'b');
+    send_chunks(first.handle, 2, 2, 'a');
+    EXPECT(wait_finalized("same-name-a"));
+    EXPECT(file_filled_with("same.bin", 'a'));
+    EXPECT(access(make_temp_path("same.bin", "same-name-b").c_str(), F_OK) == 0);
+    
+    send_chunks(second.handle, 3, 1, 'b');
+    EXPECT(wait_finalized("same-name-b"));
+    EXPECT(file_filled_with("same.bin", 'b'));
+    EXPECT(access(make_temp_path("same.bin", "same-name-a").c_str(), F_OK) != 0);
+    EXPECT(access(make_temp_path("same.bin", "same-name-b").c_str(), F_OK) != 0);
+    cleanup_file_receiver();
+    
+    return test_result("test_same_name_transfers");
+}
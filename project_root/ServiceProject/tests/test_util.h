@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+// 单元测试公用的检查：失败时打印位置并计数，不中断后续检查
+static int failures = 0;
+
+#define EXPECT(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while (0)
+
+// 在/tmp下新建临时目录并切换进去，测试产生的文件（临时文件、传输日志）都落在这里
+inline bool enter_temp_dir(const std::string& prefix) {
+    std::string dir = "/tmp/" + prefix + "_XXXXXX";
+    if (mkdtemp(&dir[0]) == nullptr || chdir(dir.c_str()) != 0) {
+        std::perror("mkdtemp");
+        return false;
+    }
+    return true;
+}
+
+// 打印测试结果，返回进程退出码
+inline int test_result(const char* name) {
+    if (failures == 0) {
+        std::printf("%s: 通过\n", name);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -3,19 +3,59 @@
 #include <cstring>
 #include <string>
 #include <ctime>
+#include <vector>
+#include <memory>
+#include <algorithm>
 
 // 文件传输系统配置宏
-#define FILE_CHUNK_SIZE 1024        // 文件块大小（1KB）
+#define FILE_CHUNK_SIZE 1024        // 文件块大小（1KB），用于逐块、FD传递和共享内存等不经会话协商的传输
 #define MAX_FILE_NAME_LENGTH 256    // 最大文件名长度
 #define MAX_TRANSFER_ID_LENGTH 64   // 最大传输ID长度
 
+// 批量发送配置：D-Bus规范限制单条消息128MiB、单个数组64MiB，
+// 这里取一个远低于上限的值，兼顾单次调用的吞吐和内存占用
+#define MAX_BATCH_BYTES (4 * 1024 * 1024)  // 单次SendFileChunks调用的最大负载字节数
+#define BATCH_CHUNK_OVERHEAD 16             // 每个(iay)元素的序列化开销估计（索引+长度+对齐）
+
+// FD传递模式下单次SendFileRange调用覆盖的字节数（FILE_CHUNK_SIZE的整数倍），
+// 拆成多个范围可让服务端多个工作线程并行拷贝
+#define FD_RANGE_BYTES (16 * 1024 * 1024)
+
+// 传输会话的块大小在OpenTransfer时协商，服务端限制在[MIN_CHUNK_SIZE, MAX_CHUNK_SIZE]范围内
+#define MIN_CHUNK_SIZE (4 * 1024)
+#define MAX_CHUNK_SIZE (8 * 1024 * 1024)
+#define DEFAULT_CHUNK_SIZE (256 * 1024)    // 默认块大小：单批约15块，1GB文件的位图只有4096位
+
+// 信用流控：服务端在会话应答中授予在途额度（字节），额度耗尽时发送端只保留一个批次在途，
+// 同步发送在额度不足一个批次时等待该毫秒数后再发下一批
+#define CREDIT_STALL_BACKOFF_MS 20
+
+// 选择性确认（SACK）：流式发送的块不等待应答，服务端每隔SACK_INTERVAL_MS把各传输新收到的块范围
+// 合并为一个ChunksAcked信号推送；发送端超过SACK_TIMEOUT_MS没有新的确认时只重传未确认的块
+#define SACK_INTERVAL_MS 50
+#define SACK_TIMEOUT_MS 2000
+
+// GetMissingRanges单页最多返回的缺失范围数
+#define MAX_MISSING_RANGES_PER_PAGE 16384
+
+// GetTransferSnapshot中位图的编码方式：
+// PACKED每字节8块（低位在前）；RLE为交替的未接收/已接收游程长度（LEB128变长整数，从未接收游程开始）
+#define BITMAP_ENCODING_PACKED 0
+#define BITMAP_ENCODING_RLE    1
+
+// 计算单次批量调用可以携带的块数（至少为1）
+inline int chunks_per_batch(size_t chunkSize) {
+    size_t count = MAX_BATCH_BYTES / (chunkSize + BATCH_CHUNK_OVERHEAD);
+    return count > 0 ? static_cast<int>(count) : 1;
+}
+
 // 文件块结构体，用于客户端和服务端之间的文件传输
 struct FileChunk {
     char userid[20];                       // 用户标识
     int fileIndex;                         // 文件块索引
     int totalChunks;                       // 总块数
     char fileName[MAX_FILE_NAME_LENGTH];   // 文件名
-    int fileLength;                        // 文件总长度
+    uint64_t fileLength;                   // 文件总长度
     mode_t fileMode;                       // 文件权限
     size_t chunkLength;                    // 当前块大小
     char data[FILE_CHUNK_SIZE];            // 文件块数据
@@ -38,7 +78,7 @@ struct FileChunk {
 
     // 带参数的构造函数
     FileChunk(const std::string& userid_, int fileIndex_, int totalChunks_,
-             const std::string& fileName_, int fileLength_, mode_t fileMode_ = 0644, bool isLastChunk_ = false)
+             const std::string& fileName_, uint64_t fileLength_, mode_t fileMode_ = 0644, bool isLastChunk_ = false)
         : fileIndex(fileIndex_), totalChunks(totalChunks_),
           fileLength(fileLength_), fileMode(fileMode_), chunkLength(0), isLastChunk(isLastChunk_) {
         
@@ -54,7 +94,7 @@ struct FileChunk {
 
     // 带传输ID的构造函数
     FileChunk(const std::string& userid_, int fileIndex_, int totalChunks_,
-             const std::string& fileName_, int fileLength_, const std::string& transferId_, 
+             const std::string& fileName_, uint64_t fileLength_, const std::string& transferId_, 
              mode_t fileMode_ = 0644, bool isLastChunk_ = false)
         : fileIndex(fileIndex_), totalChunks(totalChunks_),
           fileLength(fileLength_), fileMode(fileMode_), chunkLength(0), isLastChunk(isLastChunk_) {
@@ -71,63 +111,396 @@ struct FileChunk {
     }
 };
 
+// 文件块视图：只引用负载而不拷贝，owner保持底层缓冲区（如D-Bus消息中的GVariant）存活，
+// 同一批次的块共享一份传输元数据
+struct ChunkView {
+    std::shared_ptr<const FileChunk> meta;  // 传输元数据（不使用其中的data/fileIndex字段）
+    std::shared_ptr<const void> owner;      // 负载缓冲区的持有者
+    int fileIndex = 0;                      // 文件块索引
+    const char* data = nullptr;             // 负载起始地址
+    size_t length = 0;                      // 负载长度
+};
+
+// 传输会话的协商结果
+struct TransferSession {
+    uint32_t handle = 0;     // 会话句柄，0表示打开失败
+    uint32_t chunkSize = 0;  // 协商后的块大小
+    int totalChunks = 0;     // 按协商块大小计算的总块数
+    uint32_t credit = 0;     // 服务端授予的初始在途额度（字节）
+};
+
+// 连续的块范围[first, first + count)
+struct ChunkRange {
+    int first = 0;
+    int count = 0;
+};
+
+// 一个传输的选择性确认：snapshot为true时ranges是服务端已接收块的完整集合（OpenTransfer后推送），
+// 否则是上次确认以来新收到的块；credit是当前授予的在途额度（字节）
+struct ChunkAck {
+    std::string transferId;
+    bool snapshot = false;
+    std::vector<ChunkRange> ranges;
+    uint32_t credit = 0;
+};
+
+// 会话传输的一批文件块：负载按块大小连续存放在data中，第i块的索引为indices[i]、长度为lengths[i]
+struct ChunkBatch {
+    uint32_t chunkSize = 0;
+    std::vector<int> indices;
+    std::vector<uint32_t> lengths;
+    std::vector<char> data;
+};
+
+// 块位图：按64位字存放，另有一层摘要（每字1位）记录该字是否全满/非空，
+// 查找下一个缺失或已接收块时先在摘要中跳过整段（一个摘要字覆盖4096块）；
+// 已接收数随置位维护，完成判断为O(1)。存储在副本间共享，首次修改时才复制（写时复制），
+// 因此拷贝整个TransferStatus作为快照只是增加引用计数。非线程安全，调用方负责加锁
+class ChunkBitmap {
+public:
+    ChunkBitmap() = default;
+    explicit ChunkBitmap(int size) { reset(size); }
+
+    int size() const { return data_ ? data_->size : 0; }
+    int count() const { return data_ ? data_->count : 0; }
+    bool all() const { return count() == size(); }
+    bool none() const { return count() == 0; }
+
+    bool test(int index) const {
+        return index >= 0 && index < size() && ((data_->words[index >> 6] >> (index & 63)) & 1);
+    }
+    bool operator[](int index) const { return test(index); }
+
+    // 清空并设置长度
+    void reset(int size) {
+        data_ = size > 0 ? std::make_shared<Data>(size) : nullptr;
+    }
+
+    // 调整长度，保留已有位（缩短时丢弃越界的位）
+    void resize(int size) {
+        if (size == this->size()) {
+            return;
+        }
+        ChunkBitmap resized(size);
+        if (data_ && resized.data_) {
+            size_t words = std::min(data_->words.size(), resized.data_->words.size());
+            std::copy(data_->words.begin(), data_->words.begin() + words, resized.data_->words.begin());
+            // 缩小时尾字可能带有新长度之外的位，清掉后再重算计数和摘要
+            resized.data_->words.back() &= resized.data_->valid_mask(resized.data_->words.size() - 1);
+            resized.data_->rebuild();
+        }
+        *this = std::move(resized);
+    }
+
+    // 置位，返回该位之前是否未置位
+    bool set(int index) {
+        if (index < 0 || index >= size()) {
+            return false;
+        }
+        size_t w = static_cast<size_t>(index) >> 6;
+        uint64_t bit = 1ULL << (index & 63);
+        if (data_->words[w] & bit) {
+            return false;
+        }
+        // 置位只会让字变为非空或全满，摘要只需置位，不必像update_summary那样两边都判断
+        Data& d = mutable_data();
+        uint64_t word = d.words[w] |= bit;
+        d.count++;
+        uint64_t summary_bit = 1ULL << (w & 63);
+        d.any[w >> 6] |= summary_bit;
+        if (word == d.valid_mask(w)) {
+            d.full[w >> 6] |= summary_bit;
+        }
+        return true;
+    }
+
+    // 置位[first, first + count)，返回新置位的位数
+    int setRange(int first, int count) {
+        int end = std::min(first + count, size());
+        first = std::max(first, 0);
+        if (first >= end) {
+            return 0;
+        }
+        Data& d = mutable_data();
+        int before = d.count;
+        size_t last_word = static_cast<size_t>(end - 1) >> 6;
+        for (size_t w = static_cast<size_t>(first) >> 6; w <= last_word; ++w) {
+            uint64_t mask = ~0ULL;
+            if (w == (static_cast<size_t>(first) >> 6)) {
+                mask &= ~0ULL << (first & 63);
+            }
+            if (w == last_word && (end & 63)) {
+                mask &= ~0ULL >> (64 - (end & 63));
+            }
+            d.count += __builtin_popcountll(mask & ~d.words[w]);
+            d.words[w] |= mask;
+            d.update_summary(w);
+        }
+        return d.count - before;
+    }
+
+    // 从from开始的第一个未置位/已置位的位置，没有时返回size()
+    int findNextMissing(int from) const { return find_next(from, false); }
+    int findNextSet(int from) const { return find_next(from, true); }
+
+    // 从cursor开始按连续范围列出未置位的块，最多limit个范围；next返回下一页的起始位置，已到末尾时为0
+    std::vector<ChunkRange> missingRanges(int cursor, size_t limit, int& next) const {
+        return collect_ranges(cursor, limit, next, false);
+    }
+    // 全部已置位的连续范围
+    std::vector<ChunkRange> setRanges() const {
+        int next = 0;
+        return collect_ranges(0, static_cast<size_t>(-1), next, true);
+    }
+
+    // 低位在前的紧凑字节序列，与BITMAP_ENCODING_PACKED一致
+    std::vector<uint8_t> toBytes() const {
+        std::vector<uint8_t> bytes((size() + 7) / 8, 0);
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            bytes[i] = static_cast<uint8_t>(data_->words[i >> 3] >> ((i & 7) * 8));
+        }
+        return bytes;
+    }
+    // 从紧凑字节序列恢复长度为size的位图，bytes至少(size + 7) / 8字节
+    void assignBytes(int size, const uint8_t* bytes) {
+        reset(size);
+        if (!data_) {
+            return;
+        }
+        size_t byte_count = (static_cast<size_t>(size) + 7) / 8;
+        for (size_t i = 0; i < byte_count; ++i) {
+            data_->words[i >> 3] |= static_cast<uint64_t>(bytes[i]) << ((i & 7) * 8);
+        }
+        if (size & 63) {
+            data_->words.back() &= ~0ULL >> (64 - (size & 63));
+        }
+        data_->rebuild();
+    }
+
+private:
+    struct Data {
+        int size = 0;
+        int count = 0;
+        std::vector<uint64_t> words;
+        std::vector<uint64_t> full;    // 摘要：第w位表示words[w]的有效位全部置位
+        std::vector<uint64_t> any;     // 摘要：第w位表示words[w]非零
+
+        explicit Data(int n)
+            : size(n), words((static_cast<size_t>(n) + 63) / 64, 0),
+              full((words.size() + 63) / 64, 0), any(full.size(), 0) {}
+
+        uint64_t valid_mask(size_t w) const {
+            return (w == words.size() - 1 && (size & 63)) ? (~0ULL >> (64 - (size & 63))) : ~0ULL;
+        }
+        void update_summary(size_t w) {
+            uint64_t bit = 1ULL << (w & 63);
+            if (words[w] == valid_mask(w)) {
+                full[w >> 6] |= bit;
+            } else {
+                full[w >> 6] &= ~bit;
+            }
+            if (words[w]) {
+                any[w >> 6] |= bit;
+            } else {
+                any[w >> 6] &= ~bit;
+            }
+        }
+        void rebuild() {
+            count = 0;
+            for (size_t w = 0; w < words.size(); ++w) {
+                count += __builtin_popcountll(words[w]);
+                update_summary(w);
+            }
+        }
+    };
+
+    // 写时复制：存储被其他副本共享时先复制一份
+    Data& mutable_data() {
+        if (data_.use_count() > 1) {
+            data_ = std::make_shared<Data>(*data_);
+        }
+        return *data_;
+    }
+
+    int find_next(int from, bool value) const {
+        int n = size();
+        from = std::max(from, 0);
+        if (from >= n) {
+            return n;
+        }
+        const Data& d = *data_;
+        size_t w = static_cast<size_t>(from) >> 6;
+        uint64_t bits = (value ? d.words[w] : ~d.words[w]) & (~0ULL << (from & 63));
+        if (!bits) {
+            // 在摘要中查找下一个可能含目标位的字：找缺失跳过全满的字，找已置位跳过全零的字
+            const std::vector<uint64_t>& summary = value ? d.any : d.full;
+            size_t s = (w + 1) >> 6;
+            uint64_t candidates = 0;
+            if (s < summary.size()) {
+                candidates = (value ? summary[s] : ~summary[s]) & (~0ULL << ((w + 1) & 63));
+                while (!candidates && ++s < summary.size()) {
+                    candidates = value ? summary[s] : ~summary[s];
+                }
+            }
+            if (!candidates) {
+                return n;
+            }
+            w = (s << 6) + __builtin_ctzll(candidates);
+            if (w >= d.words.size()) {
+                return n;
+            }
+            bits = value ? d.words[w] : ~d.words[w];
+        }
+        size_t index = (w << 6) + __builtin_ctzll(bits);
+        return index < static_cast<size_t>(n) ? static_cast<int>(index) : n;
+    }
+
+    std::vector<ChunkRange> collect_ranges(int cursor, size_t limit, int& next, bool value) const {
+        std::vector<ChunkRange> ranges;
+        next = 0;
+        int n = size();
+        int i = find_next(cursor, value);
+        while (i < n) {
+            if (ranges.size() == limit) {
+                next = i;
+                break;
+            }
+            int end = find_next(i, !value);
+            ranges.push_back({i, end - i});
+            i = find_next(end, value);
+        }
+        return ranges;
+    }
+
+    std::shared_ptr<Data> data_;
+};
+
 // 传输状态结构体，用于断点续传（支持位图记录）
 struct TransferStatus {
     int totalChunks;           // 总块数
-    int fileLength;            // 文件总长度
+    uint64_t fileLength;       // 文件总长度
     int receivedChunks;        // 已接收块数
-    int receivedLength;        // 已接收长度
+    uint64_t receivedLength;   // 已接收长度
     int statusCode;            // 状态码（0=正常，1=暂停，2=错误）
     bool isCompleted;          // 是否已完成
-    std::vector<bool> chunkBitmap; // 位图：true表示已接收，false表示未接收
+    uint64_t startTime;        // 传输开始时间（Unix时间，秒）
+    uint64_t lastUpdateTime;   // 最近一次收到块的时间（Unix时间，秒）
+    ChunkBitmap chunkBitmap;   // 位图：置位表示已接收
     
     // 默认构造函数
     TransferStatus() : totalChunks(0), fileLength(0), receivedChunks(0), 
-                              receivedLength(0), statusCode(0), isCompleted(false) {}
+                              receivedLength(0), statusCode(0), isCompleted(false),
+                              startTime(0), lastUpdateTime(0) {}
     
     // 带参数的构造函数
-    TransferStatus(int total, int length) : 
+    TransferStatus(int total, uint64_t length) : 
         totalChunks(total), fileLength(length), receivedChunks(0), 
-        receivedLength(0), statusCode(0), isCompleted(false) {
-        chunkBitmap.resize(total, false);
-    }
+        receivedLength(0), statusCode(0), isCompleted(false),
+        startTime(static_cast<uint64_t>(time(nullptr))), lastUpdateTime(startTime),
+        chunkBitmap(total) {}
     
     // 标记块为已接收
-    void markChunkReceived(int chunkIndex, int chunkSize) {
-        if (chunkIndex >= 0 && chunkIndex < totalChunks && !chunkBitmap[chunkIndex]) {
-            chunkBitmap[chunkIndex] = true;
+    void markChunkReceived(int chunkIndex, size_t chunkSize) {
+        if (chunkBitmap.set(chunkIndex)) {
             receivedChunks++;
             receivedLength += chunkSize;
-            isCompleted = (receivedChunks == totalChunks);
+            isCompleted = chunkBitmap.all();
+            lastUpdateTime = static_cast<uint64_t>(time(nullptr));
+        }
+    }
+    
+    // 编码位图：分别生成紧凑位图和游程编码，返回较小的一种，encoding返回所用编码
+    std::vector<uint8_t> encodeBitmap(uint8_t& encoding) const {
+        std::vector<uint8_t> packed = chunkBitmap.toBytes();
+        std::vector<uint8_t> rle;
+        auto put_run = [&rle](uint64_t value) {
+            do {
+                uint8_t byte = value & 0x7F;
+                value >>= 7;
+                rle.push_back(value ? (byte | 0x80) : byte);
+            } while (value);
+        };
+        
+        // 游程按范围跳跃生成，已经不比紧凑位图小时提前放弃
+        int n = chunkBitmap.size();
+        bool current = false;
+        for (int i = 0; i < n && rle.size() < packed.size(); current = !current) {
+            int end = current ? chunkBitmap.findNextMissing(i) : chunkBitmap.findNextSet(i);
+            put_run(static_cast<uint64_t>(end - i));
+            i = end;
+        }
+        
+        if (n > 0 && rle.size() < packed.size()) {
+            encoding = BITMAP_ENCODING_RLE;
+            return rle;
+        }
+        encoding = BITMAP_ENCODING_PACKED;
+        return packed;
+    }
+    
+    // 按encoding解码位图到chunkBitmap（长度为totalChunks），数据不完整或编码未知时返回false
+    bool decodeBitmap(uint8_t encoding, const uint8_t* data, size_t size) {
+        chunkBitmap.reset(totalChunks);
+        if (encoding == BITMAP_ENCODING_PACKED) {
+            if (size < static_cast<size_t>((totalChunks + 7) / 8)) {
+                return false;
+            }
+            chunkBitmap.assignBytes(totalChunks, data);
+            return true;
+        }
+        if (encoding != BITMAP_ENCODING_RLE) {
+            return false;
+        }
+        
+        size_t pos = 0;
+        int index = 0;
+        bool current = false;
+        while (pos < size && index < totalChunks) {
+            uint64_t run = 0;
+            int shift = 0;
+            uint8_t byte = 0;
+            do {
+                if (pos >= size || shift > 56) {
+                    return false;
+                }
+                byte = data[pos++];
+                run |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            
+            int end = static_cast<int>(std::min<uint64_t>(static_cast<uint64_t>(index) + run, totalChunks));
+            if (current) {
+                chunkBitmap.setRange(index, end - index);
+            }
+            index = end;
+            current = !current;
         }
+        return index == totalChunks;
     }
     
     // 获取缺失的块索引列表
     std::vector<int> getMissingChunks() const {
         std::vector<int> missing;
-        for (int i = 0; i < totalChunks; ++i) {
-            if (!chunkBitmap[i]) {
-                missing.push_back(i);
-            }
+        missing.reserve(totalChunks - chunkBitmap.count());
+        for (int i = chunkBitmap.findNextMissing(0); i < totalChunks; i = chunkBitmap.findNextMissing(i + 1)) {
+            missing.push_back(i);
         }
         return missing;
     }
     
+    // 从cursor开始按连续范围列出缺失的块，最多limit个范围；
+    // next返回下一页的起始块索引，已列到末尾时为0。结果大小与缺口数成正比，而不是与块数
+    std::vector<ChunkRange> getMissingRanges(int cursor, size_t limit, int& next) const {
+        return chunkBitmap.missingRanges(cursor, limit, next);
+    }
+    
     // 重置为恢复传输状态（保留已接收的块信息）
     void resetForResume() {
-        // 重置接收计数和长度，但保留位图信息
-        receivedChunks = 0;
+        // 按位图重新计算已接收块数；无法知道每个块的具体大小，长度清零
+        receivedChunks = chunkBitmap.count();
         receivedLength = 0;
         
-        // 重新计算已接收的块数和长度
-        for (int i = 0; i < totalChunks; ++i) {
-            if (chunkBitmap[i]) {
-                receivedChunks++;
-                // 注意：这里无法知道每个块的具体大小，所以长度保持不变
-            }
-        }
-        
-        isCompleted = (receivedChunks == totalChunks);
+        isCompleted = chunkBitmap.all();
         statusCode = 0; // 重置状态码为正常
     }
 };
\ No newline at end of file
@@ -15,7 +15,7 @@ struct MemoryBlock {
     int fileIndex;       // 文件块索引
     int totalChunks;     // 总块数
     char fileName[256];  // 文件名
-    int fileLength;      // 文件总长度
+    uint64_t fileLength; // 文件总长度
     mode_t fileMode;     // 文件权限
 
     MemoryBlock();
@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// 共享内存环形缓冲区配置
+#define SHM_RING_SLOT_COUNT 64              // 槽位数量（必须为2的幂）
+#define SHM_RING_SLOT_SIZE (256 * 1024)     // 每个槽位的负载字节数（FILE_CHUNK_SIZE的整数倍）
+
+// 槽位描述，生产者/消费者通过它访问共享内存中的负载
+struct ShmSlot {
+    uint64_t pos = 0;        // 环形位置（单调递增）
+    char* data = nullptr;    // 槽位负载指针（直接指向共享内存）
+    int32_t firstIndex = 0;  // 槽位内第一个文件块的索引
+    uint32_t length = 0;     // 槽位内有效负载长度
+};
+
+// 基于memfd的多生产者/单消费者环形缓冲区，用eventfd做跨进程唤醒。
+// D-Bus只负责传递三个描述符（memfd、数据就绪eventfd、空间就绪eventfd），
+// 文件数据直接写入共享内存，不经过消息编组。
+class ShmRing {
+public:
+    /**
+     * @brief 生产者侧创建环形缓冲区（memfd + 两个eventfd）
+     * @param slot_count 槽位数量（必须为2的幂）
+     * @param slot_size 每个槽位的负载字节数
+     * @return 创建失败返回nullptr
+     */
+    static std::unique_ptr<ShmRing> create(uint32_t slot_count = SHM_RING_SLOT_COUNT,
+                                           uint32_t slot_size = SHM_RING_SLOT_SIZE);
+
+    /**
+     * @brief 消费者侧映射对端传来的环形缓冲区，成功后描述符归ShmRing所有
+     * @return 校验失败返回nullptr（此时描述符仍归调用方所有）
+     */
+    static std::unique_ptr<ShmRing> attach(int mem_fd, int data_efd, int space_efd);
+
+    ~ShmRing();
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    int mem_fd() const { return mem_fd_; }
+    int data_event_fd() const { return data_efd_; }
+    int space_event_fd() const { return space_efd_; }
+    uint32_t slot_size() const { return slot_size_; }
+
+    /**
+     * @brief 生产者：占用一个空闲槽位，环满时等待消费者释放
+     * @param timeout_ms 最长等待时间（毫秒）
+     * @return 超时或环已关闭返回false
+     */
+    bool acquire(ShmSlot& slot, int timeout_ms);
+
+    /**
+     * @brief 生产者：发布已写入数据的槽位并唤醒消费者
+     */
+    void publish(ShmSlot& slot, int32_t first_index, uint32_t length);
+
+    /**
+     * @brief 标记生产结束，消费者取完剩余槽位后即可退出
+     */
+    void close();
+
+    /**
+     * @brief 消费者：取出下一个已发布的槽位，环空时等待生产者
+     * @return 超时或（已关闭且为空）返回false
+     */
+    bool consume(ShmSlot& slot, int timeout_ms);
+
+    /**
+     * @brief 消费者：处理完成后归还槽位（可乱序归还）并唤醒生产者
+     */
+    void release(const ShmSlot& slot);
+
+    /**
+     * @brief 环是否已关闭且所有槽位都已被取出
+     */
+    bool drained() const;
+
+private:
+    struct Header;
+
+    ShmRing(int mem_fd, int data_efd, int space_efd, void* base, size_t map_size,
+            uint32_t slot_count, uint32_t slot_size);
+
+    std::atomic<uint64_t>& slot_seq(uint64_t index) const;
+    char* slot_data(uint64_t index) const;
+    static void wait_event(int efd, int timeout_ms);
+    static void signal_event(int efd);
+
+    int mem_fd_;
+    int data_efd_;
+    int space_efd_;
+    void* base_;
+    size_t map_size_;
+    Header* header_;
+    // 槽位参数在映射时读取一次，之后不再信任共享内存中的值
+    uint32_t slot_count_;
+    uint32_t slot_size_;
+};
@@ -0,0 +1,275 @@
+#include "ShmRing.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+static const uint32_t SHM_RING_MAGIC = 0x52494e47; // "RING"
+
+// 共享内存头部，生产者和消费者的索引分别独占缓存行，避免伪共享
+struct ShmRing::Header {
+    uint32_t magic;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint32_t reserved;
+    alignas(64) std::atomic<uint64_t> head;    // 生产者占用位置
+    alignas(64) std::atomic<uint64_t> tail;    // 消费者读取位置
+    alignas(64) std::atomic<uint32_t> closed;  // 生产结束标志
+};
+
+// 槽位头部：seq为Vyukov有界队列的序号，==pos表示空闲，==pos+1表示已发布
+struct SlotHeader {
+    std::atomic<uint64_t> seq;
+    int32_t firstIndex;
+    uint32_t length;
+};
+
+static const size_t SLOT_HEADER_SIZE = 64;
+static const size_t RING_HEADER_SIZE = 256;
+
+static_assert(sizeof(SlotHeader) <= SLOT_HEADER_SIZE, "slot header too large");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock-free");
+
+static size_t ring_map_size(uint32_t slot_count, uint32_t slot_size) {
+    return RING_HEADER_SIZE + static_cast<size_t>(slot_count) * (SLOT_HEADER_SIZE + slot_size);
+}
+
+ShmRing::ShmRing(int mem_fd, int data_efd, int space_efd, void* base, size_t map_size,
+                 uint32_t slot_count, uint32_t slot_size)
+    : mem_fd_(mem_fd), data_efd_(data_efd), space_efd_(space_efd),
+      base_(base), map_size_(map_size), header_(static_cast<Header*>(base)),
+      slot_count_(slot_count), slot_size_(slot_size) {}
+
+ShmRing::~ShmRing() {
+    if (base_) {
+        munmap(base_, map_size_);
+        base_ = nullptr;
+    }
+    if (mem_fd_ >= 0) ::close(mem_fd_);
+    if (data_efd_ >= 0) ::close(data_efd_);
+    if (space_efd_ >= 0) ::close(space_efd_);
+}
+
+std::unique_ptr<ShmRing> ShmRing::create(uint32_t slot_count, uint32_t slot_size) {
+    static_assert(sizeof(Header) <= RING_HEADER_SIZE, "ring header too large");
+
+    if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0 || slot_size == 0) {
+        std::cerr << "[ShmRing] 无效的环参数: slot_count=" << slot_count << " slot_size=" << slot_size << std::endl;
+        return nullptr;
+    }
+
+    size_t map_size = ring_map_size(slot_count, slot_size);
+    int mem_fd = memfd_create("file_transfer_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mem_fd < 0) {
+        std::cerr << "[ShmRing] memfd_create失败: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    if (ftruncate(mem_fd, map_size) != 0) {
+        std::cerr << "[ShmRing] 设置共享内存大小失败: " << strerror(errno) << std::endl;
+        ::close(mem_fd);
+        return nullptr;
+    }
+    // 封住大小，防止对端缩小内存导致SIGBUS
+    fcntl(mem_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+    void* base = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+    if (base == MAP_FAILED) {
+        std::cerr << "[ShmRing] 映射共享内存失败: " << strerror(errno) << std::endl;
+        ::close(mem_fd);
+        return nullptr;
+    }
+
+    int data_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    int space_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (data_efd < 0 || space_efd < 0) {
+        std::cerr << "[ShmRing] 创建eventfd失败: " << strerror(errno) << std::endl;
+        if (data_efd >= 0) ::close(data_efd);
+        if (space_efd >= 0) ::close(space_efd);
+        munmap(base, map_size);
+        ::close(mem_fd);
+        return nullptr;
+    }
+
+    // 初始化头部和所有槽位序号
+    Header* header = new (base) Header;
+    header->magic = SHM_RING_MAGIC;
+    header->slot_count = slot_count;
+    header->slot_size = slot_size;
+    header->reserved = 0;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+
+    for (uint32_t i = 0; i < slot_count; ++i) {
+        SlotHeader* slot = new (static_cast<char*>(base) + RING_HEADER_SIZE + i * (SLOT_HEADER_SIZE + slot_size)) SlotHeader;
+        slot->seq.store(i, std::memory_order_relaxed);
+        slot->firstIndex = 0;
+        slot->length = 0;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::unique_ptr<ShmRing> ring(new ShmRing(mem_fd, data_efd, space_efd, base, map_size, slot_count, slot_size));
+
+    std::cout << "[ShmRing] 创建共享内存环: " << slot_count << " 槽 x " << slot_size << " 字节" << std::endl;
+    return ring;
+}
+
+std::unique_ptr<ShmRing> ShmRing::attach(int mem_fd, int data_efd, int space_efd) {
+    struct stat st;
+    if (fstat(mem_fd, &st) != 0 || static_cast<size_t>(st.st_size) < RING_HEADER_SIZE) {
+        std::cerr << "[ShmRing] 共享内存大小无效" << std::endl;
+        return nullptr;
+    }
+
+    // 对端可能在映射后缩小文件，要求已封住大小
+    int seals = fcntl(mem_fd, F_GET_SEALS);
+    if (seals < 0 || (seals & F_SEAL_SHRINK) == 0) {
+        std::cerr << "[ShmRing] 共享内存未封住大小，拒绝映射" << std::endl;
+        return nullptr;
+    }
+
+    size_t map_size = st.st_size;
+    void* base = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+    if (base == MAP_FAILED) {
+        std::cerr << "[ShmRing] 映射共享内存失败: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    const Header* header = static_cast<const Header*>(base);
+    uint32_t slot_count = header->slot_count;
+    uint32_t slot_size = header->slot_size;
+    if (header->magic != SHM_RING_MAGIC || slot_count == 0 || (slot_count & (slot_count - 1)) != 0 ||
+        ring_map_size(slot_count, slot_size) != map_size) {
+        std::cerr << "[ShmRing] 共享内存头部校验失败" << std::endl;
+        munmap(base, map_size);
+        return nullptr;
+    }
+
+    return std::unique_ptr<ShmRing>(new ShmRing(mem_fd, data_efd, space_efd, base, map_size, slot_count, slot_size));
+}
+
+std::atomic<uint64_t>& ShmRing::slot_seq(uint64_t index) const {
+    char* p = static_cast<char*>(base_) + RING_HEADER_SIZE + index * (SLOT_HEADER_SIZE + slot_size_);
+    return reinterpret_cast<SlotHeader*>(p)->seq;
+}
+
+char* ShmRing::slot_data(uint64_t index) const {
+    return static_cast<char*>(base_) + RING_HEADER_SIZE + index * (SLOT_HEADER_SIZE + slot_size_) + SLOT_HEADER_SIZE;
+}
+
+// 等待eventfd可读并清零计数
+void ShmRing::wait_event(int efd, int timeout_ms) {
+    struct pollfd pfd = {efd, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) > 0) {
+        uint64_t value;
+        ssize_t ignored = read(efd, &value, sizeof(value));
+        (void)ignored;
+    }
+}
+
+void ShmRing::signal_event(int efd) {
+    uint64_t one = 1;
+    ssize_t ignored = write(efd, &one, sizeof(one));
+    (void)ignored;
+}
+
+bool ShmRing::acquire(ShmSlot& slot, int timeout_ms) {
+    const uint64_t mask = slot_count_ - 1;
+    // 单次等待上限，避免多个生产者争抢同一次唤醒时长时间睡眠
+    const int wait_step_ms = 10;
+    int waited_ms = 0;
+
+    while (!header_->closed.load(std::memory_order_acquire)) {
+        uint64_t pos = header_->head.load(std::memory_order_relaxed);
+        uint64_t seq = slot_seq(pos & mask).load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+
+        if (diff == 0) {
+            if (header_->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.pos = pos;
+                slot.data = slot_data(pos & mask);
+                slot.firstIndex = 0;
+                slot.length = 0;
+                return true;
+            }
+        } else if (diff < 0) {
+            // 环已满，等待消费者归还槽位
+            if (waited_ms >= timeout_ms) {
+                return false;
+            }
+            wait_event(space_efd_, wait_step_ms);
+            waited_ms += wait_step_ms;
+        }
+    }
+    return false;
+}
+
+void ShmRing::publish(ShmSlot& slot, int32_t first_index, uint32_t length) {
+    const uint64_t mask = slot_count_ - 1;
+    char* p = static_cast<char*>(base_) + RING_HEADER_SIZE + (slot.pos & mask) * (SLOT_HEADER_SIZE + slot_size_);
+    SlotHeader* slot_header = reinterpret_cast<SlotHeader*>(p);
+
+    slot.firstIndex = first_index;
+    slot.length = length > slot_size_ ? slot_size_ : length;
+    slot_header->firstIndex = slot.firstIndex;
+    slot_header->length = slot.length;
+    slot_header->seq.store(slot.pos + 1, std::memory_order_release);
+
+    signal_event(data_efd_);
+}
+
+void ShmRing::close() {
+    header_->closed.store(1, std::memory_order_release);
+    signal_event(data_efd_);
+    signal_event(space_efd_);
+}
+
+bool ShmRing::consume(ShmSlot& slot, int timeout_ms) {
+    const uint64_t mask = slot_count_ - 1;
+    uint64_t pos = header_->tail.load(std::memory_order_relaxed);
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        std::atomic<uint64_t>& seq = slot_seq(pos & mask);
+        if (seq.load(std::memory_order_acquire) == pos + 1) {
+            const char* p = slot_data(pos & mask) - SLOT_HEADER_SIZE;
+            const SlotHeader* slot_header = reinterpret_cast<const SlotHeader*>(p);
+
+            slot.pos = pos;
+            slot.data = slot_data(pos & mask);
+            slot.firstIndex = slot_header->firstIndex;
+            // 长度来自对端，重新做边界约束
+            slot.length = slot_header->length > slot_size_ ? slot_size_ : slot_header->length;
+            header_->tail.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        if (attempt == 0) {
+            // 环为空：已关闭则不再等待
+            if (header_->closed.load(std::memory_order_acquire)) {
+                return false;
+            }
+            wait_event(data_efd_, timeout_ms);
+        }
+    }
+    return false;
+}
+
+void ShmRing::release(const ShmSlot& slot) {
+    slot_seq(slot.pos & (slot_count_ - 1)).store(slot.pos + slot_count_, std::memory_order_release);
+    signal_event(space_efd_);
+}
+
+bool ShmRing::drained() const {
+    if (!header_->closed.load(std::memory_order_acquire)) {
+        return false;
+    }
+    uint64_t pos = header_->tail.load(std::memory_order_acquire);
+    return slot_seq(pos & (slot_count_ - 1)).load(std::memory_order_acquire) != pos + 1;
+}